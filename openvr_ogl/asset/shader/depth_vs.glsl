@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// position only, for the depth pre-pass
+#include "modelbuffer.glsl"
+
+void main()
+{
+	gl_Position = projectPosition(fetchModel() * vec4(aPos, 1.0f));
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec3 Position;
+
+uniform vec3 cameraPosition;
+
+#include "lighting.glsl"
+
+const vec3 handColor = vec3(0.85, 0.7, 0.6);
+
+void main()
+{
+	FragColor = vec4(shadeLights(handColor, normalize(Normal), Position, cameraPosition), 1.0);
+}
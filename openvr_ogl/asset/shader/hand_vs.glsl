@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in uvec2 aBones;
+layout (location = 1) in vec3 aShape;
+
+out vec3 Normal;
+out vec3 Position;
+
+// bone palettes of both hands streamed once per frame, four texels per matrix
+uniform samplerBuffer boneBuffer;
+uniform int boneBase;
+uniform int boneCount;
+uniform mat4 viewProj;
+
+mat4 fetchBone(int bone)
+{
+	int texel = (boneBase + gl_InstanceID * boneCount + bone) * 4;
+	return mat4(texelFetch(boneBuffer, texel), texelFetch(boneBuffer, texel + 1),
+		texelFetch(boneBuffer, texel + 2), texelFetch(boneBuffer, texel + 3));
+}
+
+void main()
+{
+	// linear blend between the two joints the vertex lies between, t = aShape.x
+	mat4 parent = fetchBone(int(aBones.x));
+	mat4 child = fetchBone(int(aBones.y));
+	vec4 offset = vec4(0.0, aShape.yz, 1.0);
+	vec4 worldPosition = mix(parent * offset, child * offset, aShape.x);
+	gl_Position = viewProj * worldPosition;
+	Normal = mix(mat3(parent), mat3(child), aShape.x) * vec3(0.0, aShape.yz);
+	Position = worldPosition.xyz;
+}
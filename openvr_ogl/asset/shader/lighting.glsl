@@ -0,0 +1,92 @@
+// shared lighting model, included by the fragment shaders: a directional light, plus the point
+// lights of the fragment's cluster with CLUSTERED_LIGHTING
+
+const float ambient = 0.3;
+const float shininess = 32.0;
+const vec3 lightColor = vec3(1.0);
+
+vec3 shadeDirectionalLight(vec3 baseColor, vec3 normal)
+{
+	// diffuse
+	vec3 lightDirection = normalize(vec3(-0.6, -1.0, -0.8));
+	float diffuse = max(dot(-lightDirection, normal), 0.0);
+	vec3 color = baseColor * ambient + baseColor * lightColor * diffuse;
+
+#ifdef ENABLE_SPECULAR
+	// specular
+	vec3 halfwayDirection = normalize(-lightDirection + normal);
+	float specular = pow(max(dot(halfwayDirection, normal), 0.0), shininess);
+	color += lightColor * specular;
+#endif
+
+	return color;
+}
+
+#ifdef CLUSTERED_LIGHTING
+// filled by ClusteredLighting every frame: two texels per light, and per cluster an offset and
+// count into the light index list, two clusters per texel and four indices per texel
+uniform samplerBuffer lightBuffer;
+uniform usamplerBuffer clusterBuffer;
+
+layout(std140) uniform ClusterGrid
+{
+	mat4 clusterView;
+	// xy: tiles per unit of tangent, zw: tangent at the edge of the first tile
+	vec4 clusterTileScale;
+	// x: slices per unit of log depth, y: log depth at the start of the first slice
+	vec4 clusterSliceScale;
+	ivec4 clusterSize;
+	// first texel of the lights, the cluster records and the light indices
+	ivec4 clusterBase;
+};
+
+vec3 shadePointLights(vec3 baseColor, vec3 normal, vec3 position, vec3 cameraPosition)
+{
+	vec3 viewPosition = (clusterView * vec4(position, 1.0)).xyz;
+	float depth = -viewPosition.z;
+	if (depth <= 0.0)
+		return vec3(0.0);
+
+	// beside the grid the nearest cluster is used, the lights' radii keep that from adding light
+	// that isn't there
+	vec3 grid = vec3((viewPosition.xy / depth - clusterTileScale.zw) * clusterTileScale.xy, (log(depth) - clusterSliceScale.y) * clusterSliceScale.x);
+	ivec3 cluster = clamp(ivec3(floor(grid)), ivec3(0), clusterSize.xyz - 1);
+	int index = (cluster.z * clusterSize.y + cluster.y) * clusterSize.x + cluster.x;
+	uvec4 records = texelFetch(clusterBuffer, clusterBase.y + index / 2);
+	uvec2 range = (index & 1) == 0 ? records.xy : records.zw;
+
+	normal = normalize(normal);
+	vec3 viewDirection = normalize(cameraPosition - position);
+	vec3 color = vec3(0.0);
+	for (uint i = 0u; i < range.y; ++i)
+	{
+		uint entry = range.x + i;
+		int light = int(texelFetch(clusterBuffer, clusterBase.z + int(entry / 4u))[entry % 4u]);
+		vec4 positionRadius = texelFetch(lightBuffer, clusterBase.x + light * 2);
+		vec4 colorIntensity = texelFetch(lightBuffer, clusterBase.x + light * 2 + 1);
+
+		// inverse square falloff, windowed to reach zero at the radius
+		vec3 toLight = positionRadius.xyz - position;
+		float distanceSquared = dot(toLight, toLight);
+		float window = clamp(1.0 - distanceSquared * distanceSquared / pow(positionRadius.w, 4.0), 0.0, 1.0);
+		vec3 radiance = colorIntensity.rgb * colorIntensity.a * window * window / (distanceSquared + 1.0);
+		vec3 lightDirection = toLight * inversesqrt(max(distanceSquared, 1e-6));
+
+		color += baseColor * radiance * max(dot(normal, lightDirection), 0.0);
+#ifdef ENABLE_SPECULAR
+		vec3 halfwayDirection = normalize(lightDirection + viewDirection);
+		color += radiance * pow(max(dot(halfwayDirection, normal), 0.0), shininess);
+#endif
+	}
+	return color;
+}
+#endif
+
+vec3 shadeLights(vec3 baseColor, vec3 normal, vec3 position, vec3 cameraPosition)
+{
+	vec3 color = shadeDirectionalLight(baseColor, normal);
+#ifdef CLUSTERED_LIGHTING
+	color += shadePointLights(baseColor, normal, position, cameraPosition);
+#endif
+	return color;
+}
@@ -0,0 +1,21 @@
+// model matrix fetch and projection shared by the render queue's vertex shaders; the depth
+// pre-pass and the shading pass must compute bit-identical positions for GL_EQUAL to match
+
+// model matrices streamed once per frame, four texels each
+uniform samplerBuffer modelBuffer;
+uniform int modelIndex;
+uniform mat4 viewProj;
+
+invariant gl_Position;
+
+mat4 fetchModel()
+{
+	int texel = modelIndex * 4;
+	return mat4(texelFetch(modelBuffer, texel), texelFetch(modelBuffer, texel + 1),
+		texelFetch(modelBuffer, texel + 2), texelFetch(modelBuffer, texel + 3));
+}
+
+vec4 projectPosition(vec4 worldPosition)
+{
+	return viewProj * worldPosition;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Normal;
+in vec2 TexCoord;
+in vec3 Position;
+flat in float Layer;
+
+// every texture of the model, one layer each
+uniform sampler2DArray diffuseTexture;
+uniform vec3 cameraPosition;
+
+#include "lighting.glsl"
+
+void main()
+{
+	vec3 baseColor = texture(diffuseTexture, vec3(TexCoord, Layer)).xyz;
+
+	FragColor = vec4(shadeLights(baseColor, normalize(Normal), Position, cameraPosition), 1.0);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in uvec2 aComponent;
+
+out vec3 Normal;
+out vec2 TexCoord;
+out vec3 Position;
+flat out float Layer;
+
+// component matrices of every device streamed once per frame, four texels per matrix
+uniform samplerBuffer paletteBuffer;
+uniform int paletteBase;
+uniform int componentCount;
+uniform mat4 viewProj;
+
+mat4 fetchComponent(int component)
+{
+	int texel = (paletteBase + gl_InstanceID * componentCount + component) * 4;
+	return mat4(texelFetch(paletteBuffer, texel), texelFetch(paletteBuffer, texel + 1),
+		texelFetch(paletteBuffer, texel + 2), texelFetch(paletteBuffer, texel + 3));
+}
+
+void main()
+{
+	mat4 model = fetchComponent(int(aComponent.x));
+	vec4 worldPosition = model * vec4(aPos, 1.0);
+	gl_Position = viewProj * worldPosition;
+	Normal = mat3(model) * aNormal;
+	TexCoord = aTexCoord;
+	Position = worldPosition.xyz;
+	Layer = float(aComponent.y);
+}
@@ -7,13 +7,14 @@ out vec3 Normal;
 out vec2 TexCoord;
 out vec3 Position;
 
-uniform mat4 model;
-uniform mat4 viewProj;
+#include "modelbuffer.glsl"
 
 void main()
 {
-	gl_Position = viewProj * model * vec4(aPos, 1.0f);
+	mat4 model = fetchModel();
+	vec4 worldPosition = model * vec4(aPos, 1.0f);
+	gl_Position = projectPosition(worldPosition);
 	Normal = (model * vec4(aNormal, 0.0f)).xyz;
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
-	Position = (model * vec4(aPos, 1.0f)).xyz;
+	Position = worldPosition.xyz;
 }
\ No newline at end of file
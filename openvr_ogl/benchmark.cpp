@@ -0,0 +1,406 @@
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <random>
+#include <chrono>
+#include <thread>
+#include <string.h>
+
+#include "shader.h"
+#include "openvrwrapper.h"
+#include "culling.h"
+#include "drawlist.h"
+#include "jobsystem.h"
+#include "frameallocator.h"
+#include "renderqueue.h"
+#include "transformsystem.h"
+
+// Micro-benchmarks of the wrapper and renderer hot paths. Each case is timed over enough calls to
+// run for MIN_RUN_TIME, best of REPEATS, and reports nanoseconds and heap allocations per
+// operation; cases over a problem size are run for several sizes to show how they scale.
+// Allocations are only counted when built with TRACK_HEAP_ALLOCATIONS.
+//
+// GL cases need an OpenGL 3.3 context from a hidden window, a software rasterizer is enough.
+// getTrackedDeviceString needs a running VR runtime. Cases whose requirements are missing are
+// reported as skipped.
+//
+// The run ends with a check that the frame path makes no heap allocations once warmed up, and
+// exits with a non-zero code if it does.
+
+static const double MIN_RUN_TIME = 0.05;
+static const int REPEATS = 5;
+
+// results are accumulated here so the compiler cannot drop the work being measured
+static volatile float sink;
+
+struct BenchmarkResult
+{
+	double nsPerOp;
+	double allocationsPerOp;
+};
+
+// Runs op, which performs opsPerCall operations per call
+template <typename Op>
+static BenchmarkResult runBenchmark(Op op, uint64_t opsPerCall)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	uint64_t calls = 1;
+	while (true)
+	{
+		Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < calls; ++i)
+		{
+			op();
+		}
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		if (seconds >= MIN_RUN_TIME || calls >= (1ull << 30))
+		{
+			break;
+		}
+		calls *= 2;
+	}
+
+	BenchmarkResult best = { 0.0, 0.0 };
+	for (int repeat = 0; repeat < REPEATS; ++repeat)
+	{
+		uint64_t allocationsBefore = getHeapAllocationCount();
+		Clock::time_point start = Clock::now();
+		for (uint64_t i = 0; i < calls; ++i)
+		{
+			op();
+		}
+		double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (calls * opsPerCall);
+		double allocations = (double)(getHeapAllocationCount() - allocationsBefore) / (calls * opsPerCall);
+		if (repeat == 0 || ns < best.nsPerOp)
+		{
+			best.nsPerOp = ns;
+			best.allocationsPerOp = allocations;
+		}
+	}
+	return best;
+}
+
+static void report(const char* name, uint32_t size, const BenchmarkResult& result)
+{
+	printf("%-32s %9u %12.2f %10.3f\n", name, size, result.nsPerOp, result.allocationsPerOp);
+}
+
+static void reportSkipped(const char* name, const char* reason)
+{
+	printf("%-32s skipped, %s\n", name, reason);
+}
+
+static vr::HmdMatrix34_t makeVRMatrix(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	vr::HmdMatrix34_t mat;
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int column = 0; column < 4; ++column)
+		{
+			mat.m[row][column] = value(random);
+		}
+	}
+	return mat;
+}
+
+struct OpenVRWrapperBenchmark
+{
+	static void run()
+	{
+		std::mt19937 random(42);
+		vr::HmdMatrix34_t matrices[vr::k_unMaxTrackedDeviceCount];
+		for (vr::HmdMatrix34_t& mat : matrices)
+		{
+			mat = makeVRMatrix(random);
+		}
+
+		report("convertOpenVRMatrixToQMatrix", 1, runBenchmark([&]()
+		{
+			for (const vr::HmdMatrix34_t& mat : matrices)
+			{
+				sink += OpenVRWrapper::convertOpenVRMatrixToQMatrix(mat)[3][0];
+			}
+		}, vr::k_unMaxTrackedDeviceCount));
+
+		OpenVRWrapper wrapper;
+		wrapper.eyeViewProjMat[0] = OpenVRWrapper::convertOpenVRMatrixToQMatrix(matrices[0]);
+		wrapper.eyeViewProjMat[1] = OpenVRWrapper::convertOpenVRMatrixToQMatrix(matrices[1]);
+		wrapper.hmdModelMat = OpenVRWrapper::convertOpenVRMatrixToQMatrix(matrices[2]);
+		report("getViewProjMat", 1, runBenchmark([&]()
+		{
+			sink += wrapper.getViewProjMat(0)[3][0] + wrapper.getViewProjMat(1)[3][0];
+		}, 2));
+
+		// device classes are already cached, so the loop makes no runtime calls
+		const uint32_t deviceCounts[] = { 1, 4, 16, 64 };
+		for (uint32_t deviceCount : deviceCounts)
+		{
+			for (uint32_t i = 0; i < vr::k_unMaxTrackedDeviceCount; ++i)
+			{
+				wrapper.trackedDevicePose[i].bPoseIsValid = i < deviceCount;
+				wrapper.trackedDevicePose[i].mDeviceToAbsoluteTracking = matrices[i];
+				wrapper.deviceClassChar[i] = i == 0 ? 'H' : 'G';
+			}
+			report("pose loop (per frame)", deviceCount, runBenchmark([&]()
+			{
+				wrapper.updateTrackedDeviceMatrices();
+				sink += wrapper.hmdModelMat[3][0];
+			}, 1));
+		}
+
+		// a background application attaches to a running runtime without starting one
+		vr::EVRInitError error = vr::VRInitError_None;
+		if (!vr::VR_IsHmdPresent() || !(wrapper.system = vr::VR_Init(&error, vr::VRApplication_Background)))
+		{
+			reportSkipped("getTrackedDeviceString", "no VR runtime running");
+			return;
+		}
+		report("getTrackedDeviceString", 1, runBenchmark([&]()
+		{
+			sink += (float)wrapper.getTrackedDeviceString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_RenderModelName_String).size();
+		}, 1));
+		vr::VR_Shutdown();
+		wrapper.system = nullptr;
+	}
+};
+
+static void runShaderBenchmarks()
+{
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "benchmark", nullptr, nullptr);
+	if (!window)
+	{
+		reportSkipped("Shader setters", "no OpenGL 3.3 context");
+		glfwTerminate();
+		return;
+	}
+	glfwMakeContextCurrent(window);
+	gladLoadGL(GLADloadfunc(glfwGetProcAddress));
+
+	ShaderVariants variants;
+	variants.init("asset/shader/simple_vs.glsl", "asset/shader/simple_fs.glsl");
+	Shader& shader = variants.get(ShaderFeature_Specular);
+	shader.use();
+
+	glm::mat4 mat = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+	glm::vec3 vec(1.0f, 2.0f, 3.0f);
+	report("Shader::setMat4", 1, runBenchmark([&]() { shader.setMat4("viewProj", mat); }, 1));
+	report("Shader::setVec3", 1, runBenchmark([&]() { shader.setVec3("cameraPosition", vec); }, 1));
+	report("Shader::setInt", 1, runBenchmark([&]() { shader.setInt("modelIndex", 1); }, 1));
+	// what the render queue does instead, with the location looked up once
+	GLint location = glGetUniformLocation(shader.ID, "viewProj");
+	report("glUniformMatrix4fv (cached)", 1, runBenchmark([&]() { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat)); }, 1));
+
+	variants.destroy();
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
+static void runTransformBenchmarks()
+{
+	const uint32_t nodeCounts[] = { 1000, 10000, 100000 };
+	TransformSystem transforms;
+	JobSystem jobs;
+	jobs.init();
+	for (uint32_t nodeCount : nodeCounts)
+	{
+		// the same shape as the scene: mostly roots, every eighth node a child of the one before
+		report("transform build (per node)", nodeCount, runBenchmark([&]()
+		{
+			transforms.clear();
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				TransformHandle parent = i % 8 == 7 ? i - 1 : INVALID_TRANSFORM;
+				transforms.create(parent, glm::vec3((float)i, 0.0f, 0.0f));
+			}
+			transforms.update();
+		}, nodeCount));
+
+		// one percent of the nodes move every frame
+		uint32_t frame = 0;
+		report("transform update 1% (per node)", nodeCount, runBenchmark([&]()
+		{
+			for (uint32_t i = frame++ % 100; i < nodeCount; i += 100)
+			{
+				transforms.setLocalPosition(i, glm::vec3((float)i, (float)frame, 0.0f));
+			}
+			transforms.update();
+		}, nodeCount));
+
+		// every node moves, serially and level by level on the job system
+		report("transform update all (per node)", nodeCount, runBenchmark([&]()
+		{
+			frame++;
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				transforms.setLocalPosition(i, glm::vec3((float)i, (float)frame, 0.0f));
+			}
+			transforms.update();
+		}, nodeCount));
+		report("transform update all, jobs (per node)", nodeCount, runBenchmark([&]()
+		{
+			frame++;
+			for (uint32_t i = 0; i < nodeCount; ++i)
+			{
+				transforms.setLocalPosition(i, glm::vec3((float)i, (float)frame, 0.0f));
+			}
+			transforms.update(&jobs);
+		}, nodeCount));
+	}
+	jobs.destroy();
+}
+
+static void runDrawListBenchmarks()
+{
+	const uint32_t objectCounts[] = { 1000, 10000, 100000, 1000000 };
+	JobSystem jobs;
+	jobs.init();
+	glm::mat4 viewProj = glm::perspective(glm::radians(110.0f), 0.9f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::combineStereo(viewProj, viewProj);
+	DrawPacket packet = { 1, 1, 1, 0, 36, 0, DepthPrepass_Never, 0, 0 };
+
+	for (uint32_t objectCount : objectCounts)
+	{
+		// the objects fill the same volume at every size, so the visible fraction stays the same
+		float extent = 50.0f;
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> position(-extent, extent);
+		TransformSystem transforms;
+		std::vector<TransformHandle> objects;
+		std::vector<AABB> bounds;
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			objects.push_back(transforms.create(INVALID_TRANSFORM, glm::vec3(position(random), position(random), position(random))));
+		}
+		transforms.update();
+		for (TransformHandle object : objects)
+		{
+			bounds.push_back(AABB::fromTransformedUnitCube(transforms.getWorldMatrix(object)));
+		}
+		BVH bvh;
+		bvh.build(bounds);
+
+		FrameAllocator frames;
+		frames.init(objectCount * sizeof(uint32_t) + 4096);
+		RenderQueue queue;
+		packet.material = queue.registerMaterial(packet.program, packet.texture);
+		std::vector<std::vector<uint32_t>> subtreeVisible;
+		FrameVector<uint32_t> visible(frames.getArena());
+		report("draw list build (per object)", objectCount, runBenchmark([&]()
+		{
+			frames.beginFrame();
+			visible = FrameVector<uint32_t>(frames.getArena());
+			visible.reserve(objectCount);
+			cullScene(jobs, bvh, frustum, subtreeVisible, visible);
+			generateDrawPackets(jobs, queue, visible, objects, transforms, packet, glm::vec3(0.0f));
+			queue.sort();
+			sink += (float)visible.size();
+		}, objectCount));
+		frames.destroy();
+	}
+	jobs.destroy();
+}
+
+// The CPU side of the app's frame without GL or a runtime: moving transforms, culling, draw
+// packets and sorting. Fails if a frame still allocates from the heap once warmed up.
+static bool runFrameAllocationCheck()
+{
+	const uint32_t objectCount = 10000;
+	const uint32_t movingCount = 100;
+	// the view turns and the moving objects swing once per warmup, so by the end of it every
+	// container has seen the largest frame it is going to see
+	const uint32_t warmupFrames = 60;
+	const uint32_t frameCount = 240;
+	if (!HeapAllocationCheck::isEnabled())
+	{
+		reportSkipped("frame heap allocation check", "built without TRACK_HEAP_ALLOCATIONS");
+		return true;
+	}
+
+	JobSystem jobs;
+	jobs.init();
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+	TransformSystem transforms;
+	std::vector<TransformHandle> objects;
+	std::vector<AABB> bounds;
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		objects.push_back(transforms.create(INVALID_TRANSFORM, glm::vec3(position(random), position(random), position(random))));
+	}
+	transforms.update();
+	// the moving objects stay out of the BVH, like the controllers in the app
+	for (uint32_t i = 0; i < objectCount - movingCount; ++i)
+	{
+		bounds.push_back(AABB::fromTransformedUnitCube(transforms.getWorldMatrix(objects[i])));
+	}
+	BVH bvh;
+	bvh.build(bounds);
+
+	glm::mat4 proj = glm::perspective(glm::radians(110.0f), 0.9f, 0.1f, 100.0f);
+	DrawPacket packet = { 1, 1, 1, 0, 36, 0, DepthPrepass_Never, 0, 0 };
+	FrameAllocator frames;
+	frames.init(objectCount * sizeof(uint32_t) + 4096);
+	RenderQueue queue;
+	packet.material = queue.registerMaterial(packet.program, packet.texture);
+	std::vector<std::vector<uint32_t>> subtreeVisible;
+	FrameVector<uint32_t> visible(frames.getArena());
+	HeapAllocationCheck check(warmupFrames);
+	for (uint32_t frame = 0; frame < warmupFrames + frameCount; ++frame)
+	{
+		check.beginFrame();
+		frames.beginFrame();
+		float angle = 6.2831853f * (frame % warmupFrames) / warmupFrames;
+		for (uint32_t i = objectCount - movingCount; i < objectCount; ++i)
+		{
+			transforms.setLocalPosition(objects[i], glm::vec3((float)i * 0.01f - 50.0f, 0.0f, -20.0f * std::sin(angle)));
+		}
+		transforms.update(&jobs);
+
+		glm::mat4 viewProj = proj * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		Frustum frustum = Frustum::combineStereo(viewProj, viewProj);
+		visible = FrameVector<uint32_t>(frames.getArena());
+		visible.reserve(objectCount);
+		cullScene(jobs, bvh, frustum, subtreeVisible, visible);
+		for (uint32_t i = objectCount - movingCount; i < objectCount; ++i)
+		{
+			if (frustum.intersects(AABB::fromTransformedUnitCube(transforms.getWorldMatrix(objects[i]))))
+			{
+				visible.push_back(i);
+			}
+		}
+		generateDrawPackets(jobs, queue, visible, objects, transforms, packet, glm::vec3(0.0f));
+		queue.sort();
+		check.endFrame();
+	}
+	frames.destroy();
+	jobs.destroy();
+
+	printf("%-32s %9u %s, %u of %u frames allocated\n", "frame heap allocation check", objectCount,
+		check.hasFailed() ? "FAILED" : "passed", check.getFailedFrameCount(), frameCount);
+	return !check.hasFailed();
+}
+
+int main()
+{
+	printf("%-32s %9s %12s %10s\n", "case", "size", "ns/op", "allocs/op");
+	OpenVRWrapperBenchmark::run();
+	runShaderBenchmarks();
+	runTransformBenchmarks();
+	runDrawListBenchmarks();
+#ifndef TRACK_HEAP_ALLOCATIONS
+	printf("Built without TRACK_HEAP_ALLOCATIONS, allocations are not counted\n");
+#endif
+	// a frame path that allocates fails the run
+	return runFrameAllocationCheck() ? 0 : 1;
+}
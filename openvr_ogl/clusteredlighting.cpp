@@ -0,0 +1,332 @@
+#include "clusteredlighting.h"
+#include "glstatecache.h"
+#include "streambuffer.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define CLUSTERED_LIGHTING_SIMD 1
+#endif
+
+// the grid starts here rather than at the near plane, nothing is lit closer than this anyway
+static const float CLUSTER_NEAR = 0.1f;
+// bytes per texel of the RGBA32F and RGBA32UI views of the stream buffer
+static const size_t TEXEL_SIZE = 16;
+
+static_assert(sizeof(PointLight) == 2 * TEXEL_SIZE, "a light is fetched as two texels");
+static_assert(ClusteredLighting::TILES_X <= 256 && ClusteredLighting::TILES_Y <= 256 && ClusteredLighting::SLICES <= 256, "light ranges are stored in bytes");
+
+void ClusteredLighting::init()
+{
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	uniformAlignment = std::max(uniformAlignment, (GLint)TEXEL_SIZE);
+	// the cluster lists are integers, read through an integer view of the stream buffer
+	glGenTextures(1, &clusterTexture);
+	clusterCounts.resize(CLUSTER_COUNT);
+	clusterFill.resize(CLUSTER_COUNT);
+}
+
+void ClusteredLighting::destroy()
+{
+	glDeleteTextures(1, &clusterTexture);
+	clusterTexture = 0;
+	clusterTextureGeneration = 0;
+}
+
+void ClusteredLighting::setupProgram(GLuint program)
+{
+	GLuint block = glGetUniformBlockIndex(program, "ClusterGrid");
+	if (block == GL_INVALID_INDEX)
+	{
+		return;
+	}
+	glUniformBlockBinding(program, block, UNIFORM_BINDING);
+	glUniform1i(glGetUniformLocation(program, "lightBuffer"), LIGHT_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "clusterBuffer"), CLUSTER_TEXTURE_UNIT);
+}
+
+void ClusteredLighting::computeGrid(const glm::mat4& viewMat, const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat)
+{
+	// the tangents spanned by both eyes' far planes; the eyes sit a few centimeters off the
+	// head's center, which only matters right at the near plane
+	glm::vec2 tanMin(FLT_MAX);
+	glm::vec2 tanMax(-FLT_MAX);
+	farDepth = CLUSTER_NEAR * 2.0f;
+	const glm::mat4 viewProjMat[2] = { leftViewProjMat, rightViewProjMat };
+	for (const glm::mat4& eyeViewProjMat : viewProjMat)
+	{
+		glm::mat4 ndcToView = viewMat * glm::inverse(eyeViewProjMat);
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			glm::vec4 position = ndcToView * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, 1.0f, 1.0f);
+			position /= position.w;
+			float depth = -position.z;
+			glm::vec2 tangent = glm::vec2(position) / depth;
+			tanMin = glm::min(tanMin, tangent);
+			tanMax = glm::max(tanMax, tangent);
+			farDepth = std::max(farDepth, depth);
+		}
+	}
+	nearDepth = CLUSTER_NEAR;
+
+	grid.view = viewMat;
+	grid.tileScale = glm::vec4(TILES_X / (tanMax.x - tanMin.x), TILES_Y / (tanMax.y - tanMin.y), tanMin.x, tanMin.y);
+	float sliceScale = SLICES / logf(farDepth / nearDepth);
+	grid.sliceScale = glm::vec4(sliceScale, logf(nearDepth), 0.0f, 0.0f);
+	grid.size = glm::ivec4(TILES_X, TILES_Y, SLICES, (int)lights.size());
+}
+
+uint32_t ClusteredLighting::getSlice(float depth) const
+{
+	float slice = (logf(std::max(depth, nearDepth)) - grid.sliceScale.y) * grid.sliceScale.x;
+	return std::min((uint32_t)slice, SLICES - 1);
+}
+
+void ClusteredLighting::computeLightRanges(const glm::mat4& viewMat)
+{
+	size_t lightCount = lights.size();
+	ranges.resize(lightCount);
+
+	// Four lights at a time: transform to view space, bound each sphere's tangents over its depth
+	// range and map them to tiles. The bounds of a sphere's box are conservative, the smallest
+	// tangent of x - r is reached at the far end of the depth range if positive, the near end if not.
+#ifdef CLUSTERED_LIGHTING_SIMD
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 nearDepth4 = _mm_set1_ps(nearDepth);
+	const __m128 farDepth4 = _mm_set1_ps(farDepth);
+#endif
+	for (size_t first = 0; first < lightCount; first += 4)
+	{
+		float px[4], py[4], pz[4], pr[4];
+		for (size_t i = 0; i < 4; ++i)
+		{
+			// the tail is padded with an invisible light
+			const PointLight* light = first + i < lightCount ? &lights[first + i] : nullptr;
+			px[i] = light ? light->position.x : 0.0f;
+			py[i] = light ? light->position.y : 0.0f;
+			pz[i] = light ? light->position.z : 0.0f;
+			pr[i] = light ? light->radius : -1.0f;
+		}
+
+		float tileMin[2][4], tileMax[2][4];
+		float nearEnd[4], farEnd[4];
+		// bit i set if light i is behind the near end, beyond the far end or padding
+		int outsideMask = 0;
+#ifdef CLUSTERED_LIGHTING_SIMD
+		__m128 x = _mm_loadu_ps(px);
+		__m128 y = _mm_loadu_ps(py);
+		__m128 z = _mm_loadu_ps(pz);
+		__m128 radius = _mm_loadu_ps(pr);
+
+		__m128 viewX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[0][0]), x), _mm_mul_ps(_mm_set1_ps(viewMat[1][0]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[2][0]), z), _mm_set1_ps(viewMat[3][0])));
+		__m128 viewY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[0][1]), x), _mm_mul_ps(_mm_set1_ps(viewMat[1][1]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[2][1]), z), _mm_set1_ps(viewMat[3][1])));
+		__m128 depth = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[0][2]), x), _mm_mul_ps(_mm_set1_ps(viewMat[1][2]), y)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(viewMat[2][2]), z), _mm_set1_ps(viewMat[3][2]))));
+
+		__m128 minDepth = _mm_max_ps(_mm_sub_ps(depth, radius), nearDepth4);
+		__m128 maxDepth = _mm_add_ps(depth, radius);
+		__m128 invMinDepth = _mm_div_ps(_mm_set1_ps(1.0f), minDepth);
+		__m128 invMaxDepth = _mm_div_ps(_mm_set1_ps(1.0f), maxDepth);
+
+		const __m128 center[2] = { viewX, viewY };
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			__m128 low = _mm_sub_ps(center[axis], radius);
+			__m128 high = _mm_add_ps(center[axis], radius);
+			__m128 lowPositive = _mm_cmpge_ps(low, zero);
+			__m128 highPositive = _mm_cmpge_ps(high, zero);
+			__m128 lowTangent = _mm_mul_ps(low, _mm_or_ps(_mm_and_ps(lowPositive, invMaxDepth), _mm_andnot_ps(lowPositive, invMinDepth)));
+			__m128 highTangent = _mm_mul_ps(high, _mm_or_ps(_mm_and_ps(highPositive, invMinDepth), _mm_andnot_ps(highPositive, invMaxDepth)));
+
+			// in tiles, still unclamped so lights beside the grid can be told apart
+			__m128 scale = _mm_set1_ps(grid.tileScale[axis]);
+			__m128 offset = _mm_set1_ps(grid.tileScale[axis + 2]);
+			_mm_storeu_ps(tileMin[axis], _mm_mul_ps(_mm_sub_ps(lowTangent, offset), scale));
+			_mm_storeu_ps(tileMax[axis], _mm_mul_ps(_mm_sub_ps(highTangent, offset), scale));
+		}
+
+		_mm_storeu_ps(nearEnd, _mm_sub_ps(depth, radius));
+		_mm_storeu_ps(farEnd, maxDepth);
+		int behind = _mm_movemask_ps(_mm_cmple_ps(maxDepth, nearDepth4));
+		int beyond = _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(depth, radius), farDepth4));
+		int invalid = _mm_movemask_ps(_mm_cmplt_ps(radius, zero));
+		outsideMask = behind | beyond | invalid;
+#else
+		for (size_t i = 0; i < 4; ++i)
+		{
+			float center[2] = {
+				viewMat[0][0] * px[i] + viewMat[1][0] * py[i] + viewMat[2][0] * pz[i] + viewMat[3][0],
+				viewMat[0][1] * px[i] + viewMat[1][1] * py[i] + viewMat[2][1] * pz[i] + viewMat[3][1]
+			};
+			float depth = -(viewMat[0][2] * px[i] + viewMat[1][2] * py[i] + viewMat[2][2] * pz[i] + viewMat[3][2]);
+			float radius = pr[i];
+			float maxDepth = depth + radius;
+			float invMinDepth = 1.0f / std::max(depth - radius, nearDepth);
+			float invMaxDepth = 1.0f / maxDepth;
+			for (int axis = 0; axis < 2; ++axis)
+			{
+				float low = center[axis] - radius;
+				float high = center[axis] + radius;
+				float lowTangent = low * (low >= 0.0f ? invMaxDepth : invMinDepth);
+				float highTangent = high * (high >= 0.0f ? invMinDepth : invMaxDepth);
+				tileMin[axis][i] = (lowTangent - grid.tileScale[axis + 2]) * grid.tileScale[axis];
+				tileMax[axis][i] = (highTangent - grid.tileScale[axis + 2]) * grid.tileScale[axis];
+			}
+			nearEnd[i] = depth - radius;
+			farEnd[i] = maxDepth;
+			if (maxDepth <= nearDepth || depth - radius >= farDepth || radius < 0.0f)
+			{
+				outsideMask |= 1 << i;
+			}
+		}
+#endif
+
+		for (size_t i = 0; i < 4 && first + i < lightCount; ++i)
+		{
+			LightRange& range = ranges[first + i];
+			bool outside = (outsideMask >> i) & 1;
+			outside = outside || tileMax[0][i] < 0.0f || tileMin[0][i] >= (float)TILES_X || tileMax[1][i] < 0.0f || tileMin[1][i] >= (float)TILES_Y;
+			if (outside)
+			{
+				range.min[0] = 1;
+				range.max[0] = 0;
+				continue;
+			}
+
+			range.min[0] = (uint8_t)std::max(tileMin[0][i], 0.0f);
+			range.max[0] = (uint8_t)std::min(tileMax[0][i], (float)(TILES_X - 1));
+			range.min[1] = (uint8_t)std::max(tileMin[1][i], 0.0f);
+			range.max[1] = (uint8_t)std::min(tileMax[1][i], (float)(TILES_Y - 1));
+			range.min[2] = (uint8_t)getSlice(nearEnd[i]);
+			range.max[2] = (uint8_t)getSlice(farEnd[i]);
+		}
+	}
+}
+
+bool ClusteredLighting::build(StreamBuffer& stream, const glm::mat4& viewMat, const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat)
+{
+	built = false;
+	stats = ClusteredLightingStats();
+	stats.lights = (uint32_t)lights.size();
+	computeGrid(viewMat, leftViewProjMat, rightViewProjMat);
+	computeLightRanges(viewMat);
+
+	// count first, so the lists can be laid out back to back in one allocation
+	std::fill(clusterCounts.begin(), clusterCounts.end(), 0);
+	for (const LightRange& range : ranges)
+	{
+		if (range.min[0] > range.max[0])
+		{
+			continue;
+		}
+		stats.visibleLights++;
+		for (uint32_t slice = range.min[2]; slice <= range.max[2]; ++slice)
+		{
+			for (uint32_t tileY = range.min[1]; tileY <= range.max[1]; ++tileY)
+			{
+				uint32_t* counts = &clusterCounts[(slice * TILES_Y + tileY) * TILES_X];
+				for (uint32_t tileX = range.min[0]; tileX <= range.max[0]; ++tileX)
+				{
+					if (counts[tileX] < MAX_CLUSTER_LIGHTS)
+					{
+						counts[tileX]++;
+						stats.entries++;
+					}
+					else
+					{
+						stats.dropped++;
+					}
+				}
+			}
+		}
+	}
+
+	StreamAllocation lightAllocation, clusterAllocation, indexAllocation, uniformAllocation;
+	size_t indexTexels = (stats.entries + 3) / 4;
+	if (!stream.allocate(std::max<size_t>(lights.size(), 1) * sizeof(PointLight), TEXEL_SIZE, lightAllocation) ||
+		!stream.allocate(CLUSTER_COUNT / 2 * TEXEL_SIZE, TEXEL_SIZE, clusterAllocation) ||
+		!stream.allocate(std::max<size_t>(indexTexels, 1) * TEXEL_SIZE, TEXEL_SIZE, indexAllocation) ||
+		!stream.allocate(sizeof(GridUniforms), uniformAlignment, uniformAllocation))
+	{
+		printf("Stream buffer is out of space for %zu lights\n", lights.size());
+		return false;
+	}
+
+	if (!lights.empty())
+	{
+		memcpy(lightAllocation.data, lights.data(), lights.size() * sizeof(PointLight));
+	}
+
+	// an offset into the index list and a count per cluster, two clusters per texel
+	uint32_t* records = (uint32_t*)clusterAllocation.data;
+	uint32_t offset = 0;
+	for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; ++cluster)
+	{
+		records[cluster * 2] = offset;
+		records[cluster * 2 + 1] = clusterCounts[cluster];
+		stats.maxClusterLights = std::max(stats.maxClusterLights, clusterCounts[cluster]);
+		clusterFill[cluster] = offset;
+		offset += clusterCounts[cluster];
+	}
+
+	// the same walk again, filling each list up to the count it got above
+	uint32_t* indices = (uint32_t*)indexAllocation.data;
+	for (uint32_t light = 0; light < (uint32_t)ranges.size(); ++light)
+	{
+		const LightRange& range = ranges[light];
+		if (range.min[0] > range.max[0])
+		{
+			continue;
+		}
+		for (uint32_t slice = range.min[2]; slice <= range.max[2]; ++slice)
+		{
+			for (uint32_t tileY = range.min[1]; tileY <= range.max[1]; ++tileY)
+			{
+				uint32_t row = (slice * TILES_Y + tileY) * TILES_X;
+				for (uint32_t tileX = range.min[0]; tileX <= range.max[0]; ++tileX)
+				{
+					uint32_t cluster = row + tileX;
+					if (clusterFill[cluster] < records[cluster * 2] + records[cluster * 2 + 1])
+					{
+						indices[clusterFill[cluster]++] = light;
+					}
+				}
+			}
+		}
+	}
+
+	grid.base = glm::ivec4((int)(lightAllocation.offset / TEXEL_SIZE), (int)(clusterAllocation.offset / TEXEL_SIZE),
+		(int)(indexAllocation.offset / TEXEL_SIZE), 0);
+	memcpy(uniformAllocation.data, &grid, sizeof(GridUniforms));
+	uniformOffset = uniformAllocation.offset;
+	built = true;
+	return true;
+}
+
+void ClusteredLighting::bind(GLStateCache& glState, const StreamBuffer& stream)
+{
+	if (!built)
+	{
+		return;
+	}
+
+	// the stream buffer is recreated when it grows, the integer view has to follow it; its texels
+	// are as large as the float view's, so the stream buffer's size limit covers both
+	if (clusterTextureGeneration != stream.getGeneration())
+	{
+		clusterTextureGeneration = stream.getGeneration();
+		glState.bindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, stream.getBuffer());
+	}
+
+	glState.bindTexture(LIGHT_TEXTURE_UNIT, GL_TEXTURE_BUFFER, stream.getTexture());
+	glState.bindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+	glState.bindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING, stream.getBuffer(), uniformOffset, sizeof(GridUniforms));
+}
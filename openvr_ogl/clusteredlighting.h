@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+class GLStateCache;
+class StreamBuffer;
+
+struct PointLight
+{
+	glm::vec3 position;
+	// the light falls off to nothing at this distance
+	float radius;
+	glm::vec3 color;
+	float intensity;
+};
+
+struct ClusteredLightingStats
+{
+	uint32_t lights = 0;
+	// lights overlapping the grid, and entries in all cluster lists together
+	uint32_t visibleLights = 0;
+	uint32_t entries = 0;
+	uint32_t maxClusterLights = 0;
+	// entries dropped because their cluster was full
+	uint32_t dropped = 0;
+};
+
+// Clustered forward shading of point lights. Every frame build() bins the lights into a froxel
+// grid: tiles of equal view space tangent across the view, slices of exponentially growing
+// depth along it. One conservative grid in the head's view space covers both eyes, so lights are
+// binned once per frame. The grid, the cluster light lists and the lights are streamed to the
+// GPU and fetched from texture buffers by lighting.glsl (CLUSTERED_LIGHTING), where each
+// fragment only loops over the lights of its own cluster.
+class ClusteredLighting
+{
+public:
+	static const GLuint LIGHT_TEXTURE_UNIT = 2;
+	static const GLuint CLUSTER_TEXTURE_UNIT = 3;
+	static const GLuint UNIFORM_BINDING = 0;
+	static const uint32_t TILES_X = 16;
+	static const uint32_t TILES_Y = 16;
+	static const uint32_t SLICES = 24;
+	static const uint32_t CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+	// caps the per fragment cost, further lights in a cluster are dropped
+	static const uint32_t MAX_CLUSTER_LIGHTS = 64;
+
+	void init();
+	void destroy();
+	// Points a program's light samplers and uniform block at the units and binding used here;
+	// only called with the program bound, programs without lighting are left alone
+	static void setupProgram(GLuint program);
+
+	void clearLights() { lights.clear(); }
+	void addLight(const PointLight& light) { lights.push_back(light); }
+
+	// Bins the lights into a grid in viewMat's view space covering both eye frustums and writes
+	// everything into this frame's region of the stream buffer. Nothing is lit if it fails.
+	bool build(StreamBuffer& stream, const glm::mat4& viewMat, const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat);
+	// binds this frame's grid and lights, after the stream buffer is committed
+	void bind(GLStateCache& glState, const StreamBuffer& stream);
+
+	// of the last build()
+	const ClusteredLightingStats& getLastStats() const { return stats; }
+
+private:
+	// std140 layout of the ClusterGrid uniform block
+	struct GridUniforms
+	{
+		glm::mat4 view;
+		// xy: tiles per unit of tangent, zw: tangent at the edge of the first tile
+		glm::vec4 tileScale;
+		// x: slices per unit of log depth, y: log depth at the start of the first slice
+		glm::vec4 sliceScale;
+		glm::ivec4 size;
+		// first texel of the lights, the cluster records and the light indices
+		glm::ivec4 base;
+	};
+
+	// inclusive cluster range of a light, empty if min > max
+	struct LightRange
+	{
+		uint8_t min[3];
+		uint8_t max[3];
+	};
+
+	void computeGrid(const glm::mat4& viewMat, const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat);
+	void computeLightRanges(const glm::mat4& viewMat);
+	uint32_t getSlice(float depth) const;
+
+	std::vector<PointLight> lights;
+	std::vector<LightRange> ranges;
+	std::vector<uint32_t> clusterCounts;
+	std::vector<uint32_t> clusterFill;
+
+	GridUniforms grid;
+	float nearDepth = 0.0f;
+	float farDepth = 0.0f;
+
+	GLuint clusterTexture = 0;
+	// StreamBuffer::getGeneration() the integer view was attached to, 0 if never
+	uint32_t clusterTextureGeneration = 0;
+	GLint uniformAlignment = 256;
+	GLintptr uniformOffset = 0;
+	bool built = false;
+
+	ClusteredLightingStats stats;
+};
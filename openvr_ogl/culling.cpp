@@ -0,0 +1,321 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define CULLING_SIMD 1
+#endif
+
+AABB AABB::fromTransformedUnitCube(const glm::mat4& modelMat)
+{
+	// the cube spans [-0.5, 0.5] on every axis, so the world extent is half the sum of the absolute basis vectors
+	glm::vec3 center(modelMat[3]);
+	glm::vec3 extent = 0.5f * (glm::abs(glm::vec3(modelMat[0])) + glm::abs(glm::vec3(modelMat[1])) + glm::abs(glm::vec3(modelMat[2])));
+	return { center - extent, center + extent };
+}
+
+Frustum Frustum::fromViewProjMat(const glm::mat4& viewProjMat)
+{
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		row[i] = glm::vec4(viewProjMat[0][i], viewProjMat[1][i], viewProjMat[2][i], viewProjMat[3][i]);
+	}
+
+	// the near plane assumes an OpenGL [-w, w] depth range, which is conservative for
+	// the [0, w] range OpenVR's projection matrices actually produce
+	Frustum frustum;
+	frustum.planes[Plane_Left] = row[3] + row[0];
+	frustum.planes[Plane_Right] = row[3] - row[0];
+	frustum.planes[Plane_Bottom] = row[3] + row[1];
+	frustum.planes[Plane_Top] = row[3] - row[1];
+	frustum.planes[Plane_Near] = row[3] + row[2];
+	frustum.planes[Plane_Far] = row[3] - row[2];
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+static void getFrustumCorners(const glm::mat4& viewProjMat, glm::vec3 corners[8])
+{
+	glm::mat4 invViewProjMat = glm::inverse(viewProjMat);
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec4 corner = invViewProjMat * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(corner) / corner.w;
+	}
+}
+
+static float getMaxViolation(const glm::vec4& plane, const glm::vec3* points, int pointCount)
+{
+	float violation = 0.0f;
+	for (int i = 0; i < pointCount; ++i)
+	{
+		violation = std::max(violation, -(glm::dot(glm::vec3(plane), points[i]) + plane.w));
+	}
+	return violation;
+}
+
+Frustum Frustum::combineStereo(const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat)
+{
+	Frustum eyeFrustum[2] = { fromViewProjMat(leftViewProjMat), fromViewProjMat(rightViewProjMat) };
+	glm::vec3 corners[16];
+	getFrustumCorners(leftViewProjMat, corners);
+	getFrustumCorners(rightViewProjMat, corners + 8);
+
+	Frustum frustum;
+	for (int i = 0; i < Plane_Count; ++i)
+	{
+		float leftViolation = getMaxViolation(eyeFrustum[0].planes[i], corners, 16);
+		float rightViolation = getMaxViolation(eyeFrustum[1].planes[i], corners, 16);
+		if (leftViolation <= rightViolation)
+		{
+			frustum.planes[i] = eyeFrustum[0].planes[i];
+			frustum.planes[i].w += leftViolation;
+		}
+		else
+		{
+			frustum.planes[i] = eyeFrustum[1].planes[i];
+			frustum.planes[i].w += rightViolation;
+		}
+	}
+	return frustum;
+}
+
+bool Frustum::intersects(const AABB& bounds) const
+{
+	glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+	glm::vec3 extent = (bounds.max - bounds.min) * 0.5f;
+	for (const glm::vec4& plane : planes)
+	{
+		glm::vec3 normal(plane);
+		if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extent) < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void BVH::build(const std::vector<AABB>& bounds)
+{
+	nodes.clear();
+	subtrees.clear();
+	objects.resize(bounds.size());
+	centroids.resize(bounds.size());
+	for (uint32_t i = 0; i < bounds.size(); ++i)
+	{
+		objects[i] = i;
+		centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+	}
+
+	if (!bounds.empty())
+	{
+		buildNode(bounds, 0, (uint32_t)bounds.size());
+		collectSubtrees(0, 0);
+	}
+}
+
+int32_t BVH::buildNode(const std::vector<AABB>& bounds, uint32_t first, uint32_t count)
+{
+	int32_t nodeIndex = (int32_t)nodes.size();
+	nodes.emplace_back();
+
+	// split the range into four groups around the quartiles of the longest centroid axis
+	uint32_t groupFirst[4];
+	uint32_t groupCount[4];
+	if (count <= 4)
+	{
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			groupFirst[i] = first + i;
+			groupCount[i] = i < count ? 1 : 0;
+		}
+	}
+	else
+	{
+		glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			centroidMin = glm::min(centroidMin, centroids[objects[i]]);
+			centroidMax = glm::max(centroidMax, centroids[objects[i]]);
+		}
+		glm::vec3 size = centroidMax - centroidMin;
+		int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+		auto less = [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; };
+		uint32_t* begin = objects.data() + first;
+		uint32_t mid = count / 2;
+		std::nth_element(begin, begin + mid, begin + count, less);
+		std::nth_element(begin, begin + mid / 2, begin + mid, less);
+		std::nth_element(begin + mid, begin + mid + (count - mid) / 2, begin + count, less);
+
+		groupFirst[0] = first;
+		groupCount[0] = mid / 2;
+		groupFirst[1] = first + mid / 2;
+		groupCount[1] = mid - mid / 2;
+		groupFirst[2] = first + mid;
+		groupCount[2] = (count - mid) / 2;
+		groupFirst[3] = first + mid + (count - mid) / 2;
+		groupCount[3] = count - mid - (count - mid) / 2;
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		int32_t child = EMPTY_CHILD;
+		AABB childBounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+		if (groupCount[i] == 1)
+		{
+			child = ~(int32_t)groupFirst[i];
+			childBounds = bounds[objects[groupFirst[i]]];
+		}
+		else if (groupCount[i] > 1)
+		{
+			child = buildNode(bounds, groupFirst[i], groupCount[i]);
+			childBounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+			for (uint32_t j = groupFirst[i]; j < groupFirst[i] + groupCount[i]; ++j)
+			{
+				childBounds.min = glm::min(childBounds.min, bounds[objects[j]].min);
+				childBounds.max = glm::max(childBounds.max, bounds[objects[j]].max);
+			}
+		}
+
+		// the vector may have grown while building children, so index instead of holding a reference
+		Node& node = nodes[nodeIndex];
+		glm::vec3 center = (childBounds.min + childBounds.max) * 0.5f;
+		glm::vec3 extent = (childBounds.max - childBounds.min) * 0.5f;
+		node.centerX[i] = center.x;
+		node.centerY[i] = center.y;
+		node.centerZ[i] = center.z;
+		node.extentX[i] = extent.x;
+		node.extentY[i] = extent.y;
+		node.extentZ[i] = extent.z;
+		node.child[i] = child;
+		node.first[i] = groupFirst[i];
+		node.count[i] = groupCount[i];
+	}
+
+	return nodeIndex;
+}
+
+void BVH::collectSubtrees(int32_t nodeIndex, int depth)
+{
+	// a node with a leaf child is culled as a whole, splitting it would classify it once per part
+	const Node& node = nodes[nodeIndex];
+	bool hasLeaf = false;
+	for (int i = 0; i < 4; ++i)
+	{
+		hasLeaf |= node.child[i] != EMPTY_CHILD && node.child[i] < 0;
+	}
+	if (depth == SUBTREE_DEPTH || hasLeaf)
+	{
+		subtrees.push_back(nodeIndex);
+		return;
+	}
+
+	// depth first, so subtree order matches the traversal order of cull()
+	for (int i = 0; i < 4; ++i)
+	{
+		if (node.child[i] != EMPTY_CHILD)
+		{
+			collectSubtrees(node.child[i], depth + 1);
+		}
+	}
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	if (!nodes.empty())
+	{
+		cullNode(0, frustum, visible);
+	}
+}
+
+void BVH::cullSubtree(uint32_t subtree, const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	cullNode(subtrees[subtree], frustum, visible);
+}
+
+void BVH::cullNode(int32_t nodeIndex, const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	const Node& node = nodes[nodeIndex];
+	int insideMask;
+	int visibleMask = classifyChildren(node, frustum, insideMask);
+	for (int i = 0; i < 4; ++i)
+	{
+		cullChild(node, i, visibleMask, insideMask, frustum, visible);
+	}
+}
+
+int BVH::classifyChildren(const Node& node, const Frustum& frustum, int& insideMask) const
+{
+	// bit i set: child i is not entirely outside / entirely inside every plane
+	int visibleMask = 0xF;
+	insideMask = 0xF;
+
+#ifdef CULLING_SIMD
+	__m128 centerX = _mm_loadu_ps(node.centerX);
+	__m128 centerY = _mm_loadu_ps(node.centerY);
+	__m128 centerZ = _mm_loadu_ps(node.centerZ);
+	__m128 extentX = _mm_loadu_ps(node.extentX);
+	__m128 extentY = _mm_loadu_ps(node.extentY);
+	__m128 extentZ = _mm_loadu_ps(node.extentZ);
+	__m128 zero = _mm_setzero_ps();
+
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		__m128 distance = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), centerX), _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), centerZ), _mm_set1_ps(plane.w)));
+		__m128 radius = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(fabsf(plane.x)), extentX), _mm_mul_ps(_mm_set1_ps(fabsf(plane.y)), extentY)),
+			_mm_mul_ps(_mm_set1_ps(fabsf(plane.z)), extentZ));
+
+		visibleMask &= ~_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		insideMask &= ~_mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+	}
+#else
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			float distance = plane.x * node.centerX[i] + plane.y * node.centerY[i] + plane.z * node.centerZ[i] + plane.w;
+			float radius = fabsf(plane.x) * node.extentX[i] + fabsf(plane.y) * node.extentY[i] + fabsf(plane.z) * node.extentZ[i];
+			if (distance + radius < 0.0f)
+				visibleMask &= ~(1 << i);
+			if (distance - radius < 0.0f)
+				insideMask &= ~(1 << i);
+		}
+	}
+#endif
+
+	return visibleMask;
+}
+
+void BVH::cullChild(const Node& node, int slot, int visibleMask, int insideMask, const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+	int32_t child = node.child[slot];
+	if (child == EMPTY_CHILD || !(visibleMask & (1 << slot)))
+	{
+		return;
+	}
+
+	if (child < 0)
+	{
+		visible.push_back(objects[~child]);
+	}
+	else if (insideMask & (1 << slot))
+	{
+		visible.insert(visible.end(), objects.begin() + node.first[slot], objects.begin() + node.first[slot] + node.count[slot]);
+	}
+	else
+	{
+		cullNode(child, frustum, visible);
+	}
+}
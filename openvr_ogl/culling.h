@@ -0,0 +1,79 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+struct AABB
+{
+	glm::vec3 min;
+	glm::vec3 max;
+
+	static AABB fromTransformedUnitCube(const glm::mat4& modelMat);
+};
+
+// Six inward facing planes (xyz = normal, w = distance), a point p is inside when dot(n, p) + w >= 0
+struct Frustum
+{
+	enum EPlane
+	{
+		Plane_Left, Plane_Right, Plane_Bottom, Plane_Top, Plane_Near, Plane_Far, Plane_Count
+	};
+
+	glm::vec4 planes[Plane_Count];
+
+	static Frustum fromViewProjMat(const glm::mat4& viewProjMat);
+	// A single frustum containing both eye frustums, so the scene is culled once per frame
+	// instead of once per eye. Each plane is taken from whichever eye bounds it tighter and
+	// then pushed out until it contains every corner of the other eye's frustum.
+	static Frustum combineStereo(const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat);
+
+	bool intersects(const AABB& bounds) const;
+};
+
+// A 4-wide bounding volume hierarchy: every node stores the bounds of its four children in
+// SoA form, so one SIMD test classifies all of them against a frustum plane at once. Children
+// fully inside the frustum accept their whole subtree without further tests.
+class BVH
+{
+public:
+	void build(const std::vector<AABB>& bounds);
+	// Appends the indices of all objects whose bounds intersect the frustum
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	// Independent subtrees for parallel culling: the nodes SUBTREE_DEPTH levels below the root, or
+	// shallower where a node has leaf children. Each is classified once, like any node in cull(),
+	// and culling them in index order yields the same list as cull().
+	uint32_t getSubtreeCount() const { return (uint32_t)subtrees.size(); }
+	void cullSubtree(uint32_t subtree, const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	size_t getObjectCount() const { return objects.size(); }
+
+private:
+	static const int32_t EMPTY_CHILD = INT32_MIN;
+	static const int SUBTREE_DEPTH = 3;
+
+	struct Node
+	{
+		float centerX[4], centerY[4], centerZ[4];
+		float extentX[4], extentY[4], extentZ[4];
+		// >= 0: inner node index, < 0: leaf holding ~child as an index into objects
+		int32_t child[4];
+		// range of objects covered by each child, used to accept fully visible subtrees
+		uint32_t first[4];
+		uint32_t count[4];
+	};
+
+	int32_t buildNode(const std::vector<AABB>& bounds, uint32_t first, uint32_t count);
+	void collectSubtrees(int32_t nodeIndex, int depth);
+	int classifyChildren(const Node& node, const Frustum& frustum, int& insideMask) const;
+	void cullChild(const Node& node, int slot, int visibleMask, int insideMask, const Frustum& frustum, std::vector<uint32_t>& visible) const;
+	void cullNode(int32_t nodeIndex, const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> objects;
+	std::vector<glm::vec3> centroids;
+	// root nodes of the subtrees
+	std::vector<int32_t> subtrees;
+};
@@ -0,0 +1,52 @@
+#include "drawlist.h"
+#include "jobsystem.h"
+
+void cullScene(JobSystem& jobs, const BVH& bvh, const Frustum& frustum, std::vector<std::vector<uint32_t>>& subtreeVisible, FrameVector<uint32_t>& visible)
+{
+	subtreeVisible.resize(bvh.getSubtreeCount());
+	jobs.parallelFor(bvh.getSubtreeCount(), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			subtreeVisible[i].clear();
+			bvh.cullSubtree(i, frustum, subtreeVisible[i]);
+		}
+	});
+
+	visible.clear();
+	for (const std::vector<uint32_t>& subtree : subtreeVisible)
+	{
+		visible.insert(visible.end(), subtree.begin(), subtree.end());
+	}
+}
+
+void generateDrawPackets(JobSystem& jobs, RenderQueue& queue, const FrameVector<uint32_t>& visible, const std::vector<TransformHandle>& renderables,
+	const TransformSystem& transforms, const DrawPacket& packet, const glm::vec3& viewPosition)
+{
+	queue.resize(visible.size());
+	jobs.parallelFor((uint32_t)visible.size(), 256, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const glm::mat4& model = transforms.getWorldMatrix(renderables[visible[i]]);
+			uint32_t depth = DrawKey::quantizeDepth(glm::length(glm::vec3(model[3]) - viewPosition), 100.0f);
+			queue.write(i, queue.makeKey(RenderPass_Opaque, DrawEye_Both, packet.material, depth), packet, model);
+		}
+	});
+}
+
+void generateDrawPackets(JobSystem& jobs, RenderQueue& queue, const FrameVector<uint32_t>& visible, const std::vector<TransformHandle>& renderables,
+	const TransformSystem& transforms, const std::vector<DrawPacket>& packets, const glm::vec3& viewPosition)
+{
+	queue.resize(visible.size());
+	jobs.parallelFor((uint32_t)visible.size(), 256, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const DrawPacket& packet = packets[visible[i]];
+			const glm::mat4& model = transforms.getWorldMatrix(renderables[visible[i]]);
+			uint32_t depth = DrawKey::quantizeDepth(glm::length(glm::vec3(model[3]) - viewPosition), 100.0f);
+			queue.write(i, queue.makeKey(RenderPass_Opaque, DrawEye_Both, packet.material, depth), packet, model);
+		}
+	});
+}
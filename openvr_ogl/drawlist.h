@@ -0,0 +1,25 @@
+#pragma once
+
+#include "culling.h"
+#include "frameallocator.h"
+#include "renderqueue.h"
+#include "transformsystem.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+
+// Cull each BVH subtree as its own job, then concatenate in subtree order so the result
+// doesn't depend on which worker finished first
+void cullScene(JobSystem& jobs, const BVH& bvh, const Frustum& frustum, std::vector<std::vector<uint32_t>>& subtreeVisible, FrameVector<uint32_t>& visible);
+
+// Every visible object writes its packet into its own queue slot, in parallel
+void generateDrawPackets(JobSystem& jobs, RenderQueue& queue, const FrameVector<uint32_t>& visible, const std::vector<TransformHandle>& renderables,
+	const TransformSystem& transforms, const DrawPacket& packet, const glm::vec3& viewPosition);
+
+// As above, with every renderable drawn with its own packet, indexed like renderables
+void generateDrawPackets(JobSystem& jobs, RenderQueue& queue, const FrameVector<uint32_t>& visible, const std::vector<TransformHandle>& renderables,
+	const TransformSystem& transforms, const std::vector<DrawPacket>& packets, const glm::vec3& viewPosition);
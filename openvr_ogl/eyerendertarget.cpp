@@ -0,0 +1,88 @@
+#include "eyerendertarget.h"
+#include "glstatecache.h"
+
+#include <stdio.h>
+
+void EyeRenderTarget::init(uint32_t width, uint32_t height, uint32_t samples, float renderScale, uint32_t swapchainLength)
+{
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	if (samples > (uint32_t)maxSamples)
+	{
+		printf("%u samples requested but only %d supported\n", samples, maxSamples);
+		samples = (uint32_t)maxSamples;
+	}
+	samples = samples == 0 ? 1 : samples;
+
+	// a multisampled framebuffer can only be blitted at 1:1, so supersampling is single sampled only
+	if (samples > 1 && renderScale != 1.0f)
+	{
+		printf("Render scale is ignored for multisampled eye targets\n");
+		renderScale = 1.0f;
+	}
+
+	this->width = width;
+	this->height = height;
+	this->samples = samples;
+	renderWidth = (uint32_t)(width * renderScale);
+	renderHeight = (uint32_t)(height * renderScale);
+
+	// the textures submitted to the compositor
+	resolveTarget.init(width, height, swapchainLength);
+
+	// nothing to resolve, render straight into the submitted textures
+	directRender = samples == 1 && renderWidth == width && renderHeight == height;
+	if (!directRender)
+	{
+		glGenFramebuffers(1, &renderFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, renderFramebuffer);
+
+		glGenRenderbuffers(1, &renderColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, renderColor);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples > 1 ? samples : 0, GL_RGBA8, renderWidth, renderHeight);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderColor);
+	}
+
+	glGenRenderbuffers(1, &renderDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderDepth);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples > 1 ? samples : 0, GL_DEPTH_COMPONENT24, renderWidth, renderHeight);
+	if (directRender)
+	{
+		resolveTarget.attachDepth(renderDepth);
+	}
+	else
+	{
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderDepth);
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Eye render target %u*%u with %u samples is incomplete\n", renderWidth, renderHeight, samples);
+	}
+}
+
+void EyeRenderTarget::destroy()
+{
+	if (!directRender)
+	{
+		glDeleteFramebuffers(1, &renderFramebuffer);
+		glDeleteRenderbuffers(1, &renderColor);
+	}
+	glDeleteRenderbuffers(1, &renderDepth);
+	resolveTarget.destroy();
+
+	renderFramebuffer = renderColor = renderDepth = 0;
+}
+
+void EyeRenderTarget::resolve(GLStateCache& glState)
+{
+	if (directRender)
+	{
+		return;
+	}
+
+	glState.bindFramebuffer(GL_READ_FRAMEBUFFER, renderFramebuffer);
+	glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveTarget.getFramebuffer());
+	glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+		renderWidth == width && renderHeight == height ? GL_NEAREST : GL_LINEAR);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "textureswapchain.h"
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+class GLStateCache;
+
+// Render target for one eye. With samples > 1 the scene is rendered into multisampled color and
+// depth renderbuffers and resolve() blits only the color into the texture handed to the
+// compositor; the multisampled depth is never resolved. With a renderScale above 1 (single
+// sampled only) the scene is supersampled and resolve() filters it down instead. The resolved
+// texture comes from a swapchain of swapchainLength textures, see TextureSwapchain.
+class EyeRenderTarget
+{
+public:
+	void init(uint32_t width, uint32_t height, uint32_t samples = 1, float renderScale = 1.0f, uint32_t swapchainLength = 1);
+	void destroy();
+
+	// acquire() before rendering a frame, release() once its resolve texture has been submitted
+	void acquire() { resolveTarget.acquire(); }
+	void release() { resolveTarget.release(); }
+	void resolve(GLStateCache& glState);
+
+	GLuint getRenderFramebuffer() const { return directRender ? resolveTarget.getFramebuffer() : renderFramebuffer; }
+	GLuint getResolveFramebuffer() const { return resolveTarget.getFramebuffer(); }
+	GLuint getResolveTexture() const { return resolveTarget.getTexture(); }
+	uint32_t getStallCount() const { return resolveTarget.getStallCount(); }
+	uint32_t getRenderWidth() const { return renderWidth; }
+	uint32_t getRenderHeight() const { return renderHeight; }
+	uint32_t getSamples() const { return samples; }
+
+private:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t renderWidth = 0;
+	uint32_t renderHeight = 0;
+	uint32_t samples = 1;
+	// rendering straight into the resolve textures, nothing to resolve
+	bool directRender = false;
+
+	GLuint renderFramebuffer = 0;
+	GLuint renderColor = 0;
+	GLuint renderDepth = 0;
+	TextureSwapchain resolveTarget;
+};
@@ -0,0 +1,75 @@
+#include "foveatedeyetarget.h"
+#include "glstatecache.h"
+
+void FoveatedEyeTarget::init(uint32_t width, uint32_t height, uint32_t samples, const FoveationLayout& layout, uint32_t swapchainLength)
+{
+	this->width = width;
+	this->height = height;
+
+	glm::ivec2 size(width, height);
+	glm::ivec2 centerMin = glm::ivec2(layout.centerMin * glm::vec2(size));
+	glm::ivec2 centerMax = glm::max(glm::ivec2(layout.centerMax * glm::vec2(size)), centerMin + 1);
+	centerRect = glm::ivec4(centerMin, centerMax);
+
+	glm::ivec2 peripherySize = glm::max(glm::ivec2(glm::vec2(size) * layout.peripheryScale), glm::ivec2(1));
+	layers[Layer_Periphery].init(peripherySize.x, peripherySize.y, samples);
+	layers[Layer_Center].init(centerMax.x - centerMin.x, centerMax.y - centerMin.y, samples);
+
+	// two periphery texels of margin cover the bilinear footprint of the upscale
+	glm::vec2 peripheryRatio = glm::vec2(peripherySize) / glm::vec2(size);
+	glm::ivec2 maskMin = glm::ivec2(glm::vec2(centerMin) * peripheryRatio) + 2;
+	glm::ivec2 maskMax = glm::ivec2(glm::vec2(centerMax) * peripheryRatio) - 2;
+	peripheryMaskRect = glm::ivec4(maskMin, glm::max(maskMax, maskMin));
+
+	// NDC scale and offset that stretch the center region over the whole center layer
+	glm::vec2 ndcMin = glm::vec2(centerMin) / glm::vec2(size) * 2.0f - 1.0f;
+	glm::vec2 ndcMax = glm::vec2(centerMax) / glm::vec2(size) * 2.0f - 1.0f;
+	glm::vec2 scale = 2.0f / (ndcMax - ndcMin);
+	glm::vec2 offset = -(ndcMin + ndcMax) * 0.5f * scale;
+
+	layerCrop[Layer_Periphery] = glm::mat4(1.0f);
+	layerCrop[Layer_Center] = glm::mat4(1.0f);
+	layerCrop[Layer_Center][0][0] = scale.x;
+	layerCrop[Layer_Center][1][1] = scale.y;
+	layerCrop[Layer_Center][3][0] = offset.x;
+	layerCrop[Layer_Center][3][1] = offset.y;
+
+	// only the composed texture is read by the compositor, the layers are never submitted
+	resolveTarget.init(width, height, swapchainLength);
+}
+
+void FoveatedEyeTarget::destroy()
+{
+	for (EyeRenderTarget& layer : layers)
+	{
+		layer.destroy();
+	}
+	resolveTarget.destroy();
+}
+
+void FoveatedEyeTarget::maskPeriphery(GLStateCache& glState)
+{
+	// with depth cleared to the near plane nothing passes the depth test inside the center
+	glState.depthMask(true);
+	glState.setEnabled(GL_SCISSOR_TEST, true);
+	glScissor(peripheryMaskRect.x, peripheryMaskRect.y, peripheryMaskRect.z - peripheryMaskRect.x, peripheryMaskRect.w - peripheryMaskRect.y);
+	glClearDepth(0.0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1.0);
+	glState.setEnabled(GL_SCISSOR_TEST, false);
+}
+
+void FoveatedEyeTarget::compose(GLStateCache& glState)
+{
+	EyeRenderTarget& periphery = layers[Layer_Periphery];
+	EyeRenderTarget& center = layers[Layer_Center];
+	periphery.resolve(glState);
+	center.resolve(glState);
+
+	glState.bindFramebuffer(GL_READ_FRAMEBUFFER, periphery.getResolveFramebuffer());
+	glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveTarget.getFramebuffer());
+	glBlitFramebuffer(0, 0, periphery.getRenderWidth(), periphery.getRenderHeight(), 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glState.bindFramebuffer(GL_READ_FRAMEBUFFER, center.getResolveFramebuffer());
+	glBlitFramebuffer(0, 0, center.getRenderWidth(), center.getRenderHeight(), centerRect.x, centerRect.y, centerRect.z, centerRect.w, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
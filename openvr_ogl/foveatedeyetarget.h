@@ -0,0 +1,49 @@
+#pragma once
+
+#include "eyerendertarget.h"
+#include "openvrwrapper.h"
+
+// Fixed foveated render target for one eye, built from two layers: the whole field of view at
+// the layout's periphery scale, and the center region at full resolution through a cropped
+// projection. compose() upscales the periphery into the submitted texture and overlays the
+// center. The center is masked out of the periphery layer with a depth clear, so those pixels
+// are never shaded twice.
+class FoveatedEyeTarget
+{
+public:
+	enum ELayer
+	{
+		Layer_Periphery, Layer_Center, Layer_Count
+	};
+
+	void init(uint32_t width, uint32_t height, uint32_t samples, const FoveationLayout& layout, uint32_t swapchainLength = 1);
+	void destroy();
+
+	// acquire() before rendering a frame, release() once its resolve texture has been submitted
+	void acquire() { resolveTarget.acquire(); }
+	void release() { resolveTarget.release(); }
+
+	EyeRenderTarget& getLayer(ELayer layer) { return layers[layer]; }
+	// maps the eye's projection onto the part of the field of view a layer covers
+	const glm::mat4& getLayerCrop(ELayer layer) const { return layerCrop[layer]; }
+
+	// call after clearing the periphery layer, before drawing into it
+	void maskPeriphery(GLStateCache& glState);
+	void compose(GLStateCache& glState);
+
+	GLuint getResolveTexture() const { return resolveTarget.getTexture(); }
+	uint32_t getStallCount() const { return resolveTarget.getStallCount(); }
+
+private:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// center region in pixels of the submitted texture
+	glm::ivec4 centerRect;
+	// center region in pixels of the periphery layer, shrunk so filtering never reads the mask
+	glm::ivec4 peripheryMaskRect;
+
+	EyeRenderTarget layers[Layer_Count];
+	glm::mat4 layerCrop[Layer_Count];
+
+	TextureSwapchain resolveTarget;
+};
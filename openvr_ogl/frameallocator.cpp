@@ -0,0 +1,193 @@
+#include "frameallocator.h"
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+static std::atomic<uint64_t> heapAllocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = malloc(size ? size : 1))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+// aligned allocations for over-aligned types (C++17) have their own overloads, counted as well
+#ifdef __cpp_aligned_new
+static void* allocateAligned(size_t size, std::align_val_t alignment)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+	void* memory = nullptr;
+	return posix_memalign(&memory, (size_t)alignment, size ? size : 1) == 0 ? memory : nullptr;
+#endif
+}
+
+static void freeAligned(void* memory)
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = allocateAligned(size, alignment))
+	{
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, alignment, tag);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
+#endif
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+void operator delete[](void* memory, size_t) noexcept { free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { free(memory); }
+
+uint64_t getHeapAllocationCount()
+{
+	return heapAllocationCount.load(std::memory_order_relaxed);
+}
+#else
+uint64_t getHeapAllocationCount()
+{
+	return 0;
+}
+#endif
+
+void LinearArena::init(size_t capacity)
+{
+	destroy();
+	memory = (uint8_t*)malloc(capacity);
+	this->capacity = memory ? capacity : 0;
+	reset();
+}
+
+void LinearArena::destroy()
+{
+	reset();
+	free(memory);
+	memory = nullptr;
+	capacity = 0;
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	// over-allocate by the alignment so the aligned start can be found without a CAS loop
+	size_t begin = head.fetch_add(size + alignment - 1, std::memory_order_relaxed);
+	size_t offset = (((uintptr_t)memory + begin + alignment - 1) & ~(uintptr_t)(alignment - 1)) - (uintptr_t)memory;
+	if (memory && offset + size <= capacity)
+	{
+		return memory + offset;
+	}
+
+	// out of space: hand out a heap block that lives until the next reset
+	overflowCount.fetch_add(1, std::memory_order_relaxed);
+#ifdef TRACK_HEAP_ALLOCATIONS
+	// a heap allocation like any other, so HeapAllocationCheck fails frames that overflow
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+#endif
+	uint8_t* block = (uint8_t*)malloc(sizeof(OverflowBlock) + size + alignment);
+	if (!block)
+	{
+		throw std::bad_alloc();
+	}
+	OverflowBlock* header = (OverflowBlock*)block;
+	header->next = overflowBlocks.load(std::memory_order_relaxed);
+	while (!overflowBlocks.compare_exchange_weak(header->next, header, std::memory_order_relaxed))
+	{
+	}
+	uintptr_t data = ((uintptr_t)block + sizeof(OverflowBlock) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	return (void*)data;
+}
+
+void LinearArena::reset()
+{
+	OverflowBlock* block = overflowBlocks.exchange(nullptr);
+	while (block)
+	{
+		OverflowBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+
+	head = 0;
+	allocationCount = 0;
+	overflowCount = 0;
+}
+
+void FrameAllocator::init(size_t capacityPerFrame)
+{
+	for (LinearArena& arena : arenas)
+	{
+		arena.init(capacityPerFrame);
+	}
+	current = 0;
+}
+
+void FrameAllocator::destroy()
+{
+	for (LinearArena& arena : arenas)
+	{
+		arena.destroy();
+	}
+}
+
+void FrameAllocator::beginFrame()
+{
+	current ^= 1;
+	arenas[current].reset();
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Counting heap allocations replaces the global operator new, so it is only compiled into
+// debug builds unless TRACK_HEAP_ALLOCATIONS is defined explicitly
+#if defined(_DEBUG) && !defined(TRACK_HEAP_ALLOCATIONS)
+#define TRACK_HEAP_ALLOCATIONS 1
+#endif
+
+// Total calls to the global operator new and LinearArena overflow blocks so far, always 0
+// without TRACK_HEAP_ALLOCATIONS
+uint64_t getHeapAllocationCount();
+
+// Fails frames that still allocate from the heap once warmupFrames have passed, by which time
+// every container should have reached its working size. Only detects anything with
+// TRACK_HEAP_ALLOCATIONS; isEnabled() tells whether it does.
+class HeapAllocationCheck
+{
+public:
+	explicit HeapAllocationCheck(uint32_t warmupFrames) : warmupFrames(warmupFrames) {}
+
+	static bool isEnabled()
+	{
+#ifdef TRACK_HEAP_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void beginFrame() { allocationsBefore = getHeapAllocationCount(); }
+
+	// false if the frame allocated after the warmup; the first such frame is reported
+	bool endFrame()
+	{
+		uint64_t allocations = getHeapAllocationCount() - allocationsBefore;
+		if (frame++ < warmupFrames || allocations == 0)
+		{
+			return true;
+		}
+		if (failedFrames++ == 0)
+		{
+			printf("Frame %u made %llu heap allocations after warmup\n", frame, (unsigned long long)allocations);
+		}
+		return false;
+	}
+
+	bool hasFailed() const { return failedFrames > 0; }
+	uint32_t getFailedFrameCount() const { return failedFrames; }
+
+private:
+	uint32_t warmupFrames;
+	uint32_t frame = 0;
+	uint32_t failedFrames = 0;
+	uint64_t allocationsBefore = 0;
+};
+
+// Bump allocator over one fixed block. Allocation is a single atomic add, so job workers can
+// allocate from it concurrently; nothing is freed individually, reset() releases everything at
+// once. Requests that do not fit fall back to the heap and are counted as overflows and as heap
+// allocations, a sign that the arena should be made larger.
+class LinearArena
+{
+public:
+	LinearArena() = default;
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+	~LinearArena() { destroy(); }
+
+	void init(size_t capacity);
+	void destroy();
+
+	void* allocate(size_t size, size_t alignment);
+	void reset();
+
+	size_t getCapacity() const { return capacity; }
+	size_t getUsed() const { return std::min(head.load(std::memory_order_relaxed), capacity); }
+	uint32_t getAllocationCount() const { return allocationCount.load(std::memory_order_relaxed); }
+	uint32_t getOverflowCount() const { return overflowCount.load(std::memory_order_relaxed); }
+
+private:
+	struct OverflowBlock
+	{
+		OverflowBlock* next;
+	};
+
+	uint8_t* memory = nullptr;
+	size_t capacity = 0;
+	std::atomic<size_t> head{ 0 };
+	std::atomic<uint32_t> allocationCount{ 0 };
+	std::atomic<uint32_t> overflowCount{ 0 };
+	std::atomic<OverflowBlock*> overflowBlocks{ nullptr };
+};
+
+// Two arenas used on alternate frames. beginFrame() resets only the arena of the frame before
+// last, so data built during one frame stays valid throughout the next, e.g. while another
+// thread renders from it.
+class FrameAllocator
+{
+public:
+	void init(size_t capacityPerFrame);
+	void destroy();
+
+	void beginFrame();
+
+	LinearArena& getArena() { return arenas[current]; }
+	const LinearArena& getArena() const { return arenas[current]; }
+
+private:
+	LinearArena arenas[2];
+	uint32_t current = 0;
+};
+
+// STL allocator drawing from a LinearArena; deallocate() is a no-op as the arena is reset as a whole
+template<typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.getArena()) {}
+
+	T* allocate(size_t count) { return (T*)arena->allocate(count * sizeof(T), alignof(T)); }
+	void deallocate(T*, size_t) {}
+
+	LinearArena* getArena() const { return arena; }
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.getArena(); }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.getArena(); }
+
+private:
+	LinearArena* arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> FrameString;
@@ -0,0 +1,93 @@
+#include "framepacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+constexpr double FramePacer::MIN_MARGIN;
+constexpr double FramePacer::MAX_MARGIN;
+constexpr double FramePacer::SPIN_TIME;
+
+// fraction an estimate moves towards a shorter sample per frame
+static const double ESTIMATE_DECAY = 0.05;
+// margin change after a late frame and per frame on time
+static const double MARGIN_GROWTH = 1.5;
+static const double MARGIN_SHRINK = 0.00001;
+
+double FramePacer::getTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void FramePacer::updateEstimate(double& estimate, double sample)
+{
+	estimate = sample > estimate ? sample : estimate + (sample - estimate) * ESTIMATE_DECAY;
+}
+
+bool FramePacer::beginFrame(double frameTimeRemaining)
+{
+	double now = getTime();
+	deadline = now + frameTimeRemaining;
+	frameStart = now;
+	if (!enabled || measuredFrames < WARMUP_FRAMES)
+	{
+		return false;
+	}
+
+	double wake = deadline - (cpuEstimate + gpuEstimate + margin);
+	if (wake <= now)
+	{
+		return false;
+	}
+
+	if (wake - now > SPIN_TIME)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double>(wake - now - SPIN_TIME));
+	}
+	while ((now = getTime()) < wake)
+	{
+		std::this_thread::yield();
+	}
+	stats.delayed += now - frameStart;
+	frameStart = now;
+	return true;
+}
+
+void FramePacer::endFrame()
+{
+	double now = getTime();
+	updateEstimate(cpuEstimate, now - frameStart);
+	measuredFrames++;
+
+	// the GPU work still has to fit between submit and the deadline
+	double slack = deadline - now - gpuEstimate;
+	if (stats.frames == 0 || slack < stats.minSlack)
+	{
+		stats.minSlack = slack;
+	}
+	stats.frames++;
+	if (slack < 0.0)
+	{
+		stats.violations++;
+		margin = std::min(margin * MARGIN_GROWTH, MAX_MARGIN);
+	}
+	else
+	{
+		margin = std::max(margin - MARGIN_SHRINK, MIN_MARGIN);
+	}
+}
+
+void FramePacer::addGpuTime(double seconds)
+{
+	updateEstimate(gpuEstimate, seconds);
+}
+
+FramePacerStats FramePacer::takeStats()
+{
+	FramePacerStats result = stats;
+	result.cpuEstimate = cpuEstimate;
+	result.gpuEstimate = gpuEstimate;
+	result.margin = margin;
+	stats = FramePacerStats();
+	return result;
+}
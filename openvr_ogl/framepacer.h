@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+struct FramePacerStats
+{
+	uint32_t frames = 0;
+	// frames whose work ran past the deadline, i.e. the safety margin was not enough
+	uint32_t violations = 0;
+	// seconds spent waiting for a later start, in total
+	double delayed = 0.0;
+	// smallest time left at submit after the estimated GPU work, negative if violated
+	double minSlack = 0.0;
+	// current estimates and margin, in seconds
+	double cpuEstimate = 0.0;
+	double gpuEstimate = 0.0;
+	double margin = 0.0;
+};
+
+// "Running start" pacing. WaitGetPoses() returns a fixed time before vsync regardless of how long
+// the frame takes to render, so a cheap frame samples its poses long before it needs them.
+// beginFrame(), called right after WaitGetPoses(), waits until only the estimated CPU and GPU
+// work plus a safety margin is left before the compositor's deadline; poses and input sampled
+// after it are that much fresher. endFrame() at submit measures the frame and adapts: the margin
+// grows quickly after a frame that ran late and shrinks slowly while frames are on time.
+class FramePacer
+{
+public:
+	// frames measured before any delay is applied
+	static const uint32_t WARMUP_FRAMES = 30;
+	static constexpr double MIN_MARGIN = 0.001;
+	static constexpr double MAX_MARGIN = 0.005;
+	// the OS sleep is only trusted up to this much before the wake time, the rest is spun
+	static constexpr double SPIN_TIME = 0.002;
+
+	void setEnabled(bool enabled) { this->enabled = enabled; }
+	bool isEnabled() const { return enabled; }
+
+	// frameTimeRemaining is the time until the compositor's deadline, taken right after
+	// WaitGetPoses(); true if it waited, in which case poses should be sampled again
+	bool beginFrame(double frameTimeRemaining);
+	// called once the frame is submitted
+	void endFrame();
+	// GPU time of a frame in seconds, whenever a measurement becomes available
+	void addGpuTime(double seconds);
+
+	// counters since the last call
+	FramePacerStats takeStats();
+
+	static double getTime();
+
+private:
+	// follows increases immediately and decreases slowly, so estimates err on the long side
+	static void updateEstimate(double& estimate, double sample);
+
+	bool enabled = true;
+	uint32_t measuredFrames = 0;
+	double frameStart = 0.0;
+	double deadline = 0.0;
+	double cpuEstimate = 0.0;
+	double gpuEstimate = 0.0;
+	double margin = MAX_MARGIN;
+	FramePacerStats stats;
+};
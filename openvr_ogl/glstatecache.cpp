@@ -0,0 +1,241 @@
+#include "glstatecache.h"
+
+static const GLuint UNKNOWN_NAME = 0xFFFFFFFF;
+static const uint8_t UNKNOWN_FLAG = 0xFF;
+static const GLenum UNKNOWN_ENUM = 0xFFFFFFFF;
+
+GLStateCache::GLStateCache()
+{
+	invalidate();
+}
+
+void GLStateCache::beginFrame()
+{
+	lastFrameStats = frameStats;
+	frameStats = GLStateStats();
+}
+
+void GLStateCache::invalidate()
+{
+	program = UNKNOWN_NAME;
+	vao = UNKNOWN_NAME;
+	for (GLuint& buffer : buffers)
+	{
+		buffer = UNKNOWN_NAME;
+	}
+	activeTextureUnit = UNKNOWN_NAME;
+	for (auto& unit : textures)
+	{
+		for (GLuint& texture : unit)
+		{
+			texture = UNKNOWN_NAME;
+		}
+	}
+	drawFramebuffer = UNKNOWN_NAME;
+	readFramebuffer = UNKNOWN_NAME;
+	viewportRect[0] = viewportRect[1] = viewportRect[2] = viewportRect[3] = -1;
+
+	for (uint8_t& capability : capabilities)
+	{
+		capability = UNKNOWN_FLAG;
+	}
+	depthWrite = UNKNOWN_FLAG;
+	colorWrite = UNKNOWN_FLAG;
+	depthCompareFunc = UNKNOWN_ENUM;
+	blendSrc = UNKNOWN_ENUM;
+	blendDst = UNKNOWN_ENUM;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (track(this->program != program))
+	{
+		this->program = program;
+		glUseProgram(program);
+	}
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+	if (track(this->vao != vao))
+	{
+		this->vao = vao;
+		glBindVertexArray(vao);
+	}
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	int index = getBufferTargetIndex(target);
+	if (index < 0)
+	{
+		track(true);
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if (track(buffers[index] != buffer))
+	{
+		buffers[index] = buffer;
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	track(true);
+	glBindBufferRange(target, index, buffer, offset, size);
+	int targetIndex = getBufferTargetIndex(target);
+	if (targetIndex >= 0)
+	{
+		buffers[targetIndex] = buffer;
+	}
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int index = getTextureTargetIndex(target);
+	if (index < 0 || unit >= MAX_TEXTURE_UNITS)
+	{
+		track(true);
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		activeTextureUnit = unit;
+		return;
+	}
+
+	if (!track(textures[unit][index] != texture))
+	{
+		return;
+	}
+
+	// the active unit is only switched when a bind on it is actually needed; the request is
+	// already counted above
+	if (activeTextureUnit != unit)
+	{
+		activeTextureUnit = unit;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	textures[unit][index] = texture;
+	glBindTexture(target, texture);
+}
+
+void GLStateCache::bindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	bool changed = (draw && drawFramebuffer != framebuffer) || (read && readFramebuffer != framebuffer);
+	if (track(changed))
+	{
+		if (draw)
+			drawFramebuffer = framebuffer;
+		if (read)
+			readFramebuffer = framebuffer;
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (track(viewportRect[0] != x || viewportRect[1] != y || viewportRect[2] != width || viewportRect[3] != height))
+	{
+		viewportRect[0] = x;
+		viewportRect[1] = y;
+		viewportRect[2] = width;
+		viewportRect[3] = height;
+		glViewport(x, y, width, height);
+	}
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled)
+{
+	int index = getCapabilityIndex(cap);
+	if (index >= 0 && !track(capabilities[index] != (uint8_t)enabled))
+	{
+		return;
+	}
+	if (index >= 0)
+	{
+		capabilities[index] = (uint8_t)enabled;
+	}
+	else
+	{
+		track(true);
+	}
+
+	enabled ? glEnable(cap) : glDisable(cap);
+}
+
+void GLStateCache::depthMask(bool enabled)
+{
+	if (track(depthWrite != (uint8_t)enabled))
+	{
+		depthWrite = (uint8_t)enabled;
+		glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (track(depthCompareFunc != func))
+	{
+		depthCompareFunc = func;
+		glDepthFunc(func);
+	}
+}
+
+void GLStateCache::colorMask(bool enabled)
+{
+	if (track(colorWrite != (uint8_t)enabled))
+	{
+		colorWrite = (uint8_t)enabled;
+		GLboolean mask = enabled ? GL_TRUE : GL_FALSE;
+		glColorMask(mask, mask, mask, mask);
+	}
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+	if (track(blendSrc != src || blendDst != dst))
+	{
+		blendSrc = src;
+		blendDst = dst;
+		glBlendFunc(src, dst);
+	}
+}
+
+int GLStateCache::getTextureTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:             return TextureTarget_2D;
+	case GL_TEXTURE_2D_MULTISAMPLE: return TextureTarget_2DMultisample;
+	case GL_TEXTURE_2D_ARRAY:       return TextureTarget_2DArray;
+	case GL_TEXTURE_BUFFER:         return TextureTarget_Buffer;
+	default:                        return -1;
+	}
+}
+
+int GLStateCache::getCapabilityIndex(GLenum cap)
+{
+	switch (cap)
+	{
+	case GL_DEPTH_TEST:   return Capability_DepthTest;
+	case GL_BLEND:        return Capability_Blend;
+	case GL_CULL_FACE:    return Capability_CullFace;
+	case GL_SCISSOR_TEST: return Capability_ScissorTest;
+	case GL_MULTISAMPLE:  return Capability_Multisample;
+	default:              return -1;
+	}
+}
+
+int GLStateCache::getBufferTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:   return BufferTarget_Array;
+	case GL_UNIFORM_BUFFER: return BufferTarget_Uniform;
+	case GL_TEXTURE_BUFFER: return BufferTarget_Texture;
+	default:                return -1;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+struct GLStateStats
+{
+	uint32_t issued = 0;
+	uint32_t elided = 0;
+};
+
+// Shadows the GL binding and fixed-function state the renderer touches and drops calls
+// that would not change anything. All state changes on the render thread should go through
+// it; call invalidate() after code outside our control (e.g. the compositor) may have
+// changed GL state behind its back.
+class GLStateCache
+{
+public:
+	static const uint32_t MAX_TEXTURE_UNITS = 16;
+
+	GLStateCache();
+
+	void beginFrame();
+	void invalidate();
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	// Binds a range to an indexed binding point such as a uniform block's. Never elided, the
+	// indexed bindings aren't shadowed, but like GL it also binds the buffer to the target.
+	void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	void bindFramebuffer(GLenum target, GLuint framebuffer);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	void setEnabled(GLenum cap, bool enabled);
+	void depthMask(bool enabled);
+	void depthFunc(GLenum func);
+	void colorMask(bool enabled);
+	void blendFunc(GLenum src, GLenum dst);
+
+	const GLStateStats& getFrameStats() const { return frameStats; }
+	const GLStateStats& getLastFrameStats() const { return lastFrameStats; }
+
+private:
+	enum ETextureTarget
+	{
+		TextureTarget_2D, TextureTarget_2DMultisample, TextureTarget_2DArray, TextureTarget_Buffer, TextureTarget_Count
+	};
+
+	enum ECapability
+	{
+		Capability_DepthTest, Capability_Blend, Capability_CullFace, Capability_ScissorTest, Capability_Multisample, Capability_Count
+	};
+
+	enum EBufferTarget
+	{
+		BufferTarget_Array, BufferTarget_Uniform, BufferTarget_Texture, BufferTarget_Count
+	};
+
+	static int getTextureTargetIndex(GLenum target);
+	static int getCapabilityIndex(GLenum cap);
+	static int getBufferTargetIndex(GLenum target);
+
+	bool track(bool changed)
+	{
+		changed ? frameStats.issued++ : frameStats.elided++;
+		return changed;
+	}
+
+	GLuint program;
+	GLuint vao;
+	GLuint buffers[BufferTarget_Count];
+	GLuint activeTextureUnit;
+	GLuint textures[MAX_TEXTURE_UNITS][TextureTarget_Count];
+	GLuint drawFramebuffer;
+	GLuint readFramebuffer;
+	GLint viewportRect[4];
+
+	// 0 = disabled, 1 = enabled, anything else = unknown
+	uint8_t capabilities[Capability_Count];
+	uint8_t depthWrite;
+	uint8_t colorWrite;
+	GLenum depthCompareFunc;
+	GLenum blendSrc;
+	GLenum blendDst;
+
+	GLStateStats frameStats;
+	GLStateStats lastFrameStats;
+};
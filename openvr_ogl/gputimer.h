@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+// Measures GPU time between begin() and end() with GL_TIME_ELAPSED queries. Results are read
+// back a few frames later from a small ring of queries, so reading never stalls the pipeline.
+class GpuTimer
+{
+public:
+	static const int QUERY_COUNT = 4;
+
+	void init()
+	{
+		glGenQueries(QUERY_COUNT, queries);
+	}
+
+	void destroy()
+	{
+		glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	void begin()
+	{
+		glBeginQuery(GL_TIME_ELAPSED, queries[current % QUERY_COUNT]);
+	}
+
+	void end()
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		current++;
+	}
+
+	// Latest available result in milliseconds, false if no query has completed yet
+	bool getLastResult(double& ms)
+	{
+		while (current - pending > 0)
+		{
+			GLuint query = queries[pending % QUERY_COUNT];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				// the ring is full, the oldest query has to be consumed before it is reused
+				if (current - pending < QUERY_COUNT)
+					break;
+			}
+
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			lastResult = elapsed / 1000000.0;
+			hasResult = true;
+			pending++;
+		}
+
+		ms = lastResult;
+		return hasResult;
+	}
+
+private:
+	GLuint queries[QUERY_COUNT];
+	int64_t current = 0;
+	int64_t pending = 0;
+	double lastResult = 0.0;
+	bool hasResult = false;
+};
@@ -0,0 +1,152 @@
+#include "handrenderer.h"
+#include "glstatecache.h"
+#include "streambuffer.h"
+#include "renderqueue.h"
+#include "shader.h"
+#include "clusteredlighting.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vector>
+#include <stddef.h>
+#include <stdio.h>
+
+// half the width of the box around a bone, palm bones start at the wrist
+static const float FINGER_RADIUS = 0.008f;
+static const float PALM_RADIUS = 0.012f;
+static const uint32_t WRIST_BONE = 1;
+static const uint32_t FIRST_AUX_BONE = 26;
+
+void HandRenderer::init(uint32_t shaderFeatures)
+{
+	Shader shader;
+	shader.init("asset/shader/hand_vs.glsl", "asset/shader/hand_fs.glsl", nullptr, ShaderPreprocessor::getFeatureDefines(shaderFeatures));
+	program = shader.ID;
+	viewProjLocation = glGetUniformLocation(program, "viewProj");
+	cameraPositionLocation = glGetUniformLocation(program, "cameraPosition");
+	boneBaseLocation = glGetUniformLocation(program, "boneBase");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "boneBuffer"), RenderQueue::MODEL_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "boneCount"), HandSkeleton::BONE_COUNT);
+	ClusteredLighting::setupProgram(program);
+
+	buildMesh();
+}
+
+void HandRenderer::destroy()
+{
+	glDeleteProgram(program);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	program = vao = vbo = 0;
+}
+
+void HandRenderer::buildMesh()
+{
+	// the four corners of the box cross-section, walked around to form its sides
+	static const float corners[4][2] = { { 1.0f, 1.0f }, { -1.0f, 1.0f }, { -1.0f, -1.0f }, { 1.0f, -1.0f } };
+
+	std::vector<Vertex> vertices;
+	for (uint32_t bone = WRIST_BONE + 1; bone < FIRST_AUX_BONE; ++bone)
+	{
+		uint32_t parent = (uint32_t)HandSkeleton::getParent(bone);
+		float radius = parent == WRIST_BONE ? PALM_RADIUS : FINGER_RADIUS;
+		for (int side = 0; side < 4; ++side)
+		{
+			const float* a = corners[side];
+			const float* b = corners[(side + 1) % 4];
+			// two triangles per side, t = 0 at the parent joint and t = 1 at the child joint
+			const float quad[6][3] = {
+				{ 0.0f, a[0], a[1] }, { 1.0f, a[0], a[1] }, { 1.0f, b[0], b[1] },
+				{ 0.0f, a[0], a[1] }, { 1.0f, b[0], b[1] }, { 0.0f, b[0], b[1] },
+			};
+			for (const float* corner : quad)
+			{
+				Vertex vertex = {};
+				vertex.bones[0] = (uint8_t)parent;
+				vertex.bones[1] = (uint8_t)bone;
+				vertex.t = corner[0];
+				vertex.offset[0] = corner[1] * radius;
+				vertex.offset[1] = corner[2] * radius;
+				vertices.push_back(vertex);
+			}
+		}
+	}
+	vertexCount = (GLsizei)vertices.size();
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glVertexAttribIPointer(0, 2, GL_UNSIGNED_BYTE, sizeof(Vertex), (void*)offsetof(Vertex, bones));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, t));
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+}
+
+bool HandRenderer::upload(StreamBuffer& stream, const HandSkeleton& skeleton, const InputSystem& input)
+{
+	boneBase = -1;
+	if (!skeleton.isActive(InputSource_LeftHand) && !skeleton.isActive(InputSource_RightHand))
+	{
+		return false;
+	}
+
+	StreamAllocation allocation;
+	if (!stream.allocate(InputSource_Count * HandSkeleton::BONE_COUNT * sizeof(glm::mat4), sizeof(glm::mat4), allocation))
+	{
+		printf("Stream buffer is out of space for the hand bone palette\n");
+		return false;
+	}
+
+	glm::mat4* palette = (glm::mat4*)allocation.data;
+	for (uint32_t hand = 0; hand < InputSource_Count; ++hand)
+	{
+		glm::mat4* handPalette = palette + hand * HandSkeleton::BONE_COUNT;
+		EInputSource source = (EInputSource)hand;
+		EAction action = source == InputSource_LeftHand ? Action_SkeletonLeft : Action_SkeletonRight;
+		if (!skeleton.isActive(source) || !input.isPoseValid(action))
+		{
+			// collapses the hand to a point, its triangles are discarded before rasterization
+			for (uint32_t i = 0; i < HandSkeleton::BONE_COUNT; ++i)
+			{
+				handPalette[i] = glm::mat4(0.0f);
+			}
+			continue;
+		}
+
+		// bones are in the hand's model space, the skeleton action's pose places the hand
+		const glm::mat4& handMat = input.getPose(action);
+		const glm::vec3* positions = skeleton.getPositions(source);
+		const glm::quat* rotations = skeleton.getRotations(source);
+		for (uint32_t i = 0; i < HandSkeleton::BONE_COUNT; ++i)
+		{
+			glm::mat4 boneMat = glm::mat4_cast(rotations[i]);
+			boneMat[3] = glm::vec4(positions[i], 1.0f);
+			handPalette[i] = handMat * boneMat;
+		}
+	}
+
+	boneTexture = stream.getTexture();
+	boneBase = (int32_t)(allocation.offset / sizeof(glm::mat4));
+	return true;
+}
+
+void HandRenderer::draw(GLStateCache& glState, const glm::mat4& viewProjMat, const glm::vec3& viewPosition)
+{
+	if (boneBase < 0)
+	{
+		return;
+	}
+
+	glState.useProgram(program);
+	glState.bindVertexArray(vao);
+	glState.bindTexture(RenderQueue::MODEL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, boneTexture);
+	glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, glm::value_ptr(viewProjMat));
+	glUniform3fv(cameraPositionLocation, 1, glm::value_ptr(viewPosition));
+	glUniform1i(boneBaseLocation, boneBase);
+	// one instance per hand
+	glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, InputSource_Count);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "handskeleton.h"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <stdint.h>
+
+class GLStateCache;
+class StreamBuffer;
+
+// Draws both skeletal hands with GPU skinning. The mesh is generated once: a box around every
+// bone from a joint to its child, each vertex skinned by the two joint matrices it lies between.
+// Per frame, upload() writes a palette of both hands' bone matrices into the stream buffer and
+// draw() renders both hands in one instanced call, the instance selecting the hand's palette.
+class HandRenderer
+{
+public:
+	void init(uint32_t shaderFeatures);
+	void destroy();
+
+	// false if neither hand is tracked, nothing is drawn then
+	bool upload(StreamBuffer& stream, const HandSkeleton& skeleton, const InputSystem& input);
+	void draw(GLStateCache& glState, const glm::mat4& viewProjMat, const glm::vec3& viewPosition);
+
+private:
+	struct Vertex
+	{
+		// joint matrices blended between, from t = 0 to t = 1
+		uint8_t bones[2];
+		uint8_t padding[2];
+		float t;
+		// cross-section offset in the plane across the bone
+		float offset[2];
+	};
+
+	void buildMesh();
+
+	GLuint program = 0;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLsizei vertexCount = 0;
+	GLint viewProjLocation = -1;
+	GLint cameraPositionLocation = -1;
+	GLint boneBaseLocation = -1;
+
+	GLuint boneTexture = 0;
+	// index of the first palette matrix in the texture buffer, -1 if not uploaded this frame
+	int32_t boneBase = -1;
+};
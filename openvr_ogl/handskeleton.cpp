@@ -0,0 +1,64 @@
+#include "handskeleton.h"
+
+#include <stdio.h>
+
+static const int32_t BONE_PARENTS[HandSkeleton::BONE_COUNT] =
+{
+	-1, 0,
+	// thumb
+	1, 2, 3, 4,
+	// index, middle, ring and pinky
+	1, 6, 7, 8, 9,
+	1, 11, 12, 13, 14,
+	1, 16, 17, 18, 19,
+	1, 21, 22, 23, 24,
+	// aux bones
+	0, 0, 0, 0, 0,
+};
+
+int32_t HandSkeleton::getParent(uint32_t bone)
+{
+	return BONE_PARENTS[bone];
+}
+
+void HandSkeleton::update(const InputSystem& input)
+{
+	lastTransferSize = 0;
+	active[InputSource_LeftHand] = updateHand(input, InputSource_LeftHand);
+	active[InputSource_RightHand] = updateHand(input, InputSource_RightHand);
+}
+
+bool HandSkeleton::updateHand(const InputSystem& input, EInputSource hand)
+{
+	EAction action = hand == InputSource_LeftHand ? Action_SkeletonLeft : Action_SkeletonRight;
+	vr::VRActionHandle_t handle = input.getActionHandle(action);
+	if (handle == vr::k_ulInvalidActionHandle || !input.isActive(action))
+	{
+		return false;
+	}
+
+	uint32_t size = 0;
+	vr::EVRInputError inputError = vr::VRInput()->GetSkeletalBoneDataCompressed(handle, vr::VRSkeletalMotionRange_WithController,
+		compressed, COMPRESSED_CAPACITY, &size);
+	if (inputError != vr::VRInputError_None)
+	{
+		// no skeleton for this hand right now, e.g. the controller has no skeletal driver
+		return false;
+	}
+	lastTransferSize += size;
+
+	inputError = vr::VRInput()->DecompressSkeletalBoneData(compressed, size, vr::VRSkeletalTransformSpace_Model, decompressed, BONE_COUNT);
+	if (inputError != vr::VRInputError_None)
+	{
+		printf("Failed to decompress skeletal bone data, error: %d\n", inputError);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < BONE_COUNT; ++i)
+	{
+		const vr::VRBoneTransform_t& bone = decompressed[i];
+		positions[hand][i] = glm::vec3(bone.position.v[0], bone.position.v[1], bone.position.v[2]);
+		rotations[hand][i] = glm::quat(bone.orientation.w, bone.orientation.x, bone.orientation.y, bone.orientation.z);
+	}
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "inputsystem.h"
+
+#include <openvr.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <stdint.h>
+
+// Bone transforms of both hands from the skeletal input actions. Each hand is read with a single
+// GetSkeletalBoneDataCompressed() call, which moves a few hundred bytes instead of the full
+// transform array, and decompressed into model space (relative to the hand's pose). Positions and
+// rotations are kept in separate arrays, the layout the skinning palette is built from.
+class HandSkeleton
+{
+public:
+	// the OpenVR hand skeleton: root, wrist, four bones per thumb, five per finger, five aux bones
+	static const uint32_t BONE_COUNT = 31;
+	// upper bound of the compressed size of BONE_COUNT bones documented by the runtime
+	static const uint32_t COMPRESSED_CAPACITY = BONE_COUNT * sizeof(vr::VRBoneTransform_t) + 2;
+
+	// parent of each bone, -1 for the root
+	static int32_t getParent(uint32_t bone);
+
+	void update(const InputSystem& input);
+
+	bool isActive(EInputSource hand) const { return active[hand]; }
+	const glm::vec3* getPositions(EInputSource hand) const { return positions[hand]; }
+	const glm::quat* getRotations(EInputSource hand) const { return rotations[hand]; }
+	// compressed bytes transferred by the last update() for both hands
+	uint32_t getLastTransferSize() const { return lastTransferSize; }
+
+private:
+	bool updateHand(const InputSystem& input, EInputSource hand);
+
+	glm::vec3 positions[InputSource_Count][BONE_COUNT];
+	glm::quat rotations[InputSource_Count][BONE_COUNT];
+	bool active[InputSource_Count] = {};
+	uint32_t lastTransferSize = 0;
+
+	uint8_t compressed[COMPRESSED_CAPACITY];
+	vr::VRBoneTransform_t decompressed[BONE_COUNT];
+};
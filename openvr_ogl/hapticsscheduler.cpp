@@ -0,0 +1,194 @@
+#include "hapticsscheduler.h"
+#include "inputsystem.h"
+
+#include <algorithm>
+#include <chrono>
+
+constexpr double HapticsScheduler::MIN_ISSUE_INTERVAL;
+constexpr double HapticsScheduler::ISSUE_LOOKAHEAD;
+
+HapticsScheduler::HapticsScheduler()
+{
+	for (uint32_t i = 0; i < QUEUE_CAPACITY; ++i)
+	{
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void HapticsScheduler::init(uint32_t actionCount)
+{
+	actions.assign(actionCount, ActionSchedule());
+}
+
+double HapticsScheduler::getTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool HapticsScheduler::submit(uint32_t action, float delay, float duration, float frequency, float amplitude)
+{
+	submittedCount.fetch_add(1, std::memory_order_relaxed);
+
+	uint32_t position = enqueuePosition.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true)
+	{
+		slot = &slots[position % QUEUE_CAPACITY];
+		int32_t difference = (int32_t)(slot->sequence.load(std::memory_order_acquire) - position);
+		if (difference == 0)
+		{
+			if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			position = enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	double start = getTime() + std::max(delay, 0.0f);
+	slot->pulse = { action, start, start + std::max(duration, 0.0f), frequency, amplitude };
+	slot->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool HapticsScheduler::pop(Pulse& pulse)
+{
+	Slot& slot = slots[dequeuePosition % QUEUE_CAPACITY];
+	if (slot.sequence.load(std::memory_order_acquire) != dequeuePosition + 1)
+	{
+		return false;
+	}
+
+	pulse = slot.pulse;
+	slot.sequence.store(dequeuePosition + QUEUE_CAPACITY, std::memory_order_release);
+	dequeuePosition++;
+	return true;
+}
+
+void HapticsScheduler::schedule(const Pulse& pulse)
+{
+	if (pulse.action >= actions.size())
+	{
+		stats.dropped++;
+		return;
+	}
+	ActionSchedule& schedule = actions[pulse.action];
+
+	// the part already covered by an equally strong pulse the runtime is playing needs no new call
+	Pulse remaining = pulse;
+	if (pulse.amplitude <= schedule.issuedAmplitude)
+	{
+		remaining.start = std::max(remaining.start, schedule.issuedEnd);
+		if (remaining.start >= remaining.end)
+		{
+			stats.coalesced++;
+			return;
+		}
+	}
+
+	for (uint32_t i = 0; i < schedule.pendingCount; ++i)
+	{
+		Pulse& pending = schedule.pending[i];
+		if (remaining.start <= pending.end && pending.start <= remaining.end)
+		{
+			// the merged pulse plays the union at the stronger of the two settings
+			if (remaining.amplitude > pending.amplitude)
+			{
+				pending.amplitude = remaining.amplitude;
+				pending.frequency = remaining.frequency;
+			}
+			pending.start = std::min(pending.start, remaining.start);
+			pending.end = std::max(pending.end, remaining.end);
+			stats.coalesced++;
+			return;
+		}
+	}
+
+	if (schedule.pendingCount == MAX_PENDING_PER_ACTION)
+	{
+		stats.dropped++;
+		return;
+	}
+
+	// kept sorted by start time so the earliest pulse is issued first
+	uint32_t index = schedule.pendingCount++;
+	while (index > 0 && schedule.pending[index - 1].start > remaining.start)
+	{
+		schedule.pending[index] = schedule.pending[index - 1];
+		index--;
+	}
+	schedule.pending[index] = remaining;
+}
+
+void HapticsScheduler::flush(InputSystem& input)
+{
+	Pulse pulse;
+	while (pop(pulse))
+	{
+		schedule(pulse);
+	}
+
+	double now = getTime();
+	uint32_t issues = 0;
+	for (uint32_t action = 0; action < actions.size(); ++action)
+	{
+		ActionSchedule& schedule = actions[action];
+
+		// drop what ran out while waiting for the rate limit
+		uint32_t kept = 0;
+		for (uint32_t i = 0; i < schedule.pendingCount; ++i)
+		{
+			if (schedule.pending[i].end > now)
+			{
+				schedule.pending[kept++] = schedule.pending[i];
+			}
+			else
+			{
+				stats.expired++;
+			}
+		}
+		schedule.pendingCount = kept;
+
+		if (kept == 0 || now < schedule.nextIssueTime || issues == MAX_ISSUES_PER_FLUSH)
+		{
+			continue;
+		}
+
+		const Pulse& next = schedule.pending[0];
+		if (next.start > now + ISSUE_LOOKAHEAD)
+		{
+			continue;
+		}
+
+		double start = std::max(next.start, now);
+		input.triggerHaptic(action, (float)(start - now), (float)(next.end - start), next.frequency, next.amplitude);
+		schedule.issuedEnd = next.end;
+		schedule.issuedAmplitude = next.amplitude;
+		schedule.nextIssueTime = now + MIN_ISSUE_INTERVAL;
+		issues++;
+		stats.issued++;
+
+		schedule.pendingCount--;
+		for (uint32_t i = 0; i < schedule.pendingCount; ++i)
+		{
+			schedule.pending[i] = schedule.pending[i + 1];
+		}
+	}
+}
+
+HapticsStats HapticsScheduler::takeStats()
+{
+	HapticsStats result = stats;
+	result.submitted = submittedCount.exchange(0, std::memory_order_relaxed);
+	result.dropped += droppedCount.exchange(0, std::memory_order_relaxed);
+	stats = HapticsStats();
+	return result;
+}
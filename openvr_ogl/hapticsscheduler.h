@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+
+class InputSystem;
+
+struct HapticsStats
+{
+	uint32_t submitted = 0;
+	// rejected because the queue or the action's schedule was full, or the action unknown
+	uint32_t dropped = 0;
+	// merged into an overlapping pulse on the same action
+	uint32_t coalesced = 0;
+	// ended before the rate limit allowed issuing them
+	uint32_t expired = 0;
+	// runtime calls made
+	uint32_t issued = 0;
+};
+
+// Collects haptic pulses from any thread and plays them from one place. submit() pushes into a
+// bounded lock-free queue; flush(), called once per frame on the input thread, drains it,
+// merges pulses that overlap on the same haptic action and issues at most one runtime call per
+// action every MIN_ISSUE_INTERVAL seconds, and MAX_ISSUES_PER_FLUSH in total, so bursts of
+// interaction turn into a few IPC calls instead of one each.
+class HapticsScheduler
+{
+public:
+	static const uint32_t QUEUE_CAPACITY = 256;
+	static const uint32_t MAX_PENDING_PER_ACTION = 8;
+	static const uint32_t MAX_ISSUES_PER_FLUSH = 4;
+	static constexpr double MIN_ISSUE_INTERVAL = 0.02;
+	// pulses starting within this many seconds are handed to the runtime ahead of time
+	static constexpr double ISSUE_LOOKAHEAD = 0.01;
+
+	HapticsScheduler();
+
+	// sizes the per action schedules up front, so flush() never allocates; pulses on actions
+	// outside [0, actionCount) are dropped
+	void init(uint32_t actionCount);
+
+	// Thread safe. delay is in seconds from now; false if the queue is full.
+	bool submit(uint32_t action, float delay, float duration, float frequency, float amplitude);
+	void flush(InputSystem& input);
+
+	// counters since the last call
+	HapticsStats takeStats();
+
+	// seconds on the clock pulses are scheduled against
+	static double getTime();
+
+private:
+	struct Pulse
+	{
+		uint32_t action;
+		double start;
+		double end;
+		float frequency;
+		float amplitude;
+	};
+
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		Pulse pulse;
+	};
+
+	struct ActionSchedule
+	{
+		Pulse pending[MAX_PENDING_PER_ACTION];
+		uint32_t pendingCount = 0;
+		double nextIssueTime = 0.0;
+		// end of the last pulse handed to the runtime
+		double issuedEnd = 0.0;
+		float issuedAmplitude = 0.0f;
+	};
+
+	bool pop(Pulse& pulse);
+	void schedule(const Pulse& pulse);
+
+	// Vyukov style bounded queue: each slot's sequence tells producers and the consumer whose turn it is
+	Slot slots[QUEUE_CAPACITY];
+	std::atomic<uint32_t> enqueuePosition{ 0 };
+	uint32_t dequeuePosition = 0;
+
+	std::vector<ActionSchedule> actions;
+	HapticsStats stats;
+	std::atomic<uint32_t> submittedCount{ 0 };
+	std::atomic<uint32_t> droppedCount{ 0 };
+};
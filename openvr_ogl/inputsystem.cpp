@@ -0,0 +1,345 @@
+#include "inputsystem.h"
+#include "json.h"
+#include "vreventbus.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <limits.h>
+#endif
+
+static const char* const ACTION_NAMES[Action_Count] =
+{
+	"/actions/main/in/trigger",
+	"/actions/main/in/trackpad",
+	"/actions/main/in/grip",
+	"/actions/main/in/hand_left",
+	"/actions/main/in/hand_right",
+	"/actions/main/out/haptic_left",
+	"/actions/main/out/haptic_right",
+	"/actions/main/in/skeleton_left",
+	"/actions/main/in/skeleton_right",
+};
+
+static const char* const SOURCE_PATHS[InputSource_Count] =
+{
+	"/user/hand/left",
+	"/user/hand/right",
+};
+
+static glm::mat4 convertPoseMatrix(const vr::HmdMatrix34_t& mat)
+{
+	return glm::mat4(
+		mat.m[0][0], mat.m[1][0], mat.m[2][0], 0.0,
+		mat.m[0][1], mat.m[1][1], mat.m[2][1], 0.0,
+		mat.m[0][2], mat.m[1][2], mat.m[2][2], 0.0,
+		mat.m[0][3], mat.m[1][3], mat.m[2][3], 1.0f
+	);
+}
+
+bool InputSystem::init(const char* manifestPath)
+{
+	actions.clear();
+	actionSets.clear();
+	for (uint32_t i = 0; i < Action_Count; ++i)
+	{
+		Action action;
+		action.name = ACTION_NAMES[i];
+		actions.push_back(action);
+	}
+	states.assign(actions.size(), ActionState());
+
+	std::ifstream file(manifestPath);
+	if (!file)
+	{
+		printf("Failed to open action manifest %s\n", manifestPath);
+		return false;
+	}
+	std::stringstream stream;
+	stream << file.rdbuf();
+
+	JsonValue manifest;
+	std::string error;
+	if (!JsonValue::parse(stream.str().c_str(), manifest, error))
+	{
+		printf("Failed to parse action manifest %s, %s\n", manifestPath, error.c_str());
+		return false;
+	}
+	const JsonValue* manifestActions = manifest.find("actions");
+	if (!manifestActions || !manifestActions->isArray())
+	{
+		printf("Action manifest %s has no actions\n", manifestPath);
+		return false;
+	}
+
+	// the manifest decides the type of every action; actions the application has no enum for are appended
+	for (const JsonValue& entry : manifestActions->getElements())
+	{
+		const JsonValue* name = entry.find("name");
+		const JsonValue* type = entry.find("type");
+		if (!name || !name->isString() || !type || !type->isString())
+		{
+			printf("Skipping action manifest entry without name or type\n");
+			continue;
+		}
+
+		uint32_t index = findAction(name->getString().c_str());
+		if (index == INVALID_ACTION)
+		{
+			index = (uint32_t)actions.size();
+			actions.emplace_back();
+			actions.back().name = name->getString();
+		}
+		actions[index].type = parseActionType(type->getString());
+		if (actions[index].type == ActionType_Unknown)
+		{
+			printf("Action %s has unknown type %s\n", name->getString().c_str(), type->getString().c_str());
+		}
+	}
+	states.assign(actions.size(), ActionState());
+
+	// OpenVR resolves the bindings relative to the manifest, which needs an absolute path
+#ifdef _WIN32
+	char absolutePath[_MAX_PATH];
+	bool resolved = _fullpath(absolutePath, manifestPath, sizeof(absolutePath)) != nullptr;
+#else
+	char absolutePath[PATH_MAX];
+	bool resolved = realpath(manifestPath, absolutePath) != nullptr;
+#endif
+	if (!resolved)
+	{
+		printf("Failed to resolve the absolute path of %s\n", manifestPath);
+		return false;
+	}
+
+	vr::EVRInputError inputError = vr::VRInput()->SetActionManifestPath(absolutePath);
+	if (inputError != vr::VRInputError_None)
+	{
+		printf("Failed to SetActionManifestPath %s, error: %d\n", absolutePath, inputError);
+		return false;
+	}
+
+	std::vector<std::string> actionSetNames;
+	for (Action& action : actions)
+	{
+		if (action.type == ActionType_Unknown)
+		{
+			printf("Action %s is not declared in the manifest\n", action.name.c_str());
+			continue;
+		}
+
+		inputError = vr::VRInput()->GetActionHandle(action.name.c_str(), &action.handle);
+		if (inputError != vr::VRInputError_None)
+		{
+			printf("Failed to get action handle for %s, error: %d\n", action.name.c_str(), inputError);
+			action.handle = vr::k_ulInvalidActionHandle;
+			continue;
+		}
+
+		// "/actions/<set>/in/<name>" belongs to the set "/actions/<set>"
+		size_t setEnd = action.name.find('/', action.name.find('/', 1) + 1);
+		std::string setName = action.name.substr(0, setEnd);
+		if (std::find(actionSetNames.begin(), actionSetNames.end(), setName) == actionSetNames.end())
+		{
+			actionSetNames.push_back(setName);
+		}
+	}
+
+	for (const std::string& setName : actionSetNames)
+	{
+		vr::VRActiveActionSet_t activeSet = {};
+		inputError = vr::VRInput()->GetActionSetHandle(setName.c_str(), &activeSet.ulActionSet);
+		if (inputError != vr::VRInputError_None)
+		{
+			printf("Failed to get action set handle for %s, error: %d\n", setName.c_str(), inputError);
+			continue;
+		}
+		activeSet.ulRestrictedToDevice = vr::k_ulInvalidInputValueHandle;
+		activeSet.ulSecondaryActionSet = vr::k_ulInvalidActionSetHandle;
+		actionSets.push_back(activeSet);
+	}
+
+	for (uint32_t i = 0; i < InputSource_Count; ++i)
+	{
+		inputError = vr::VRInput()->GetInputSourceHandle(SOURCE_PATHS[i], &sources[i]);
+		if (inputError != vr::VRInputError_None)
+		{
+			printf("Failed to get input source handle for %s, error: %d\n", SOURCE_PATHS[i], inputError);
+			sources[i] = vr::k_ulInvalidInputValueHandle;
+		}
+	}
+
+	printf("Input: %u actions in %u action sets\n", (uint32_t)actions.size(), (uint32_t)actionSets.size());
+	return true;
+}
+
+void InputSystem::update(float poseSecondsFromNow)
+{
+	if (actionSets.empty())
+	{
+		return;
+	}
+
+	vr::EVRInputError inputError = vr::VRInput()->UpdateActionState(actionSets.data(), sizeof(vr::VRActiveActionSet_t), (uint32_t)actionSets.size());
+	if (inputError != vr::VRInputError_None)
+	{
+		// the held state carries over, but last frame's edges must not fire again
+		for (ActionState& state : states)
+		{
+			state.pressed = false;
+			state.released = false;
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < actions.size(); ++i)
+	{
+		const Action& action = actions[i];
+		ActionState& state = states[i];
+		if (action.handle == vr::k_ulInvalidActionHandle)
+		{
+			continue;
+		}
+
+		switch (action.type)
+		{
+		case ActionType_Boolean:
+		{
+			vr::InputDigitalActionData_t data;
+			bool valid = vr::VRInput()->GetDigitalActionData(action.handle, &data, sizeof(data), vr::k_ulInvalidInputValueHandle) == vr::VRInputError_None;
+			bool wasDown = state.down;
+			state.active = valid && data.bActive;
+			state.down = state.active && data.bState;
+			state.pressed = state.down && !wasDown;
+			state.released = !state.down && wasDown;
+			if (state.active)
+			{
+				resolveOrigin(state, data.activeOrigin);
+			}
+		}
+		break;
+		case ActionType_Vector1:
+		case ActionType_Vector2:
+		case ActionType_Vector3:
+		{
+			vr::InputAnalogActionData_t data;
+			bool valid = vr::VRInput()->GetAnalogActionData(action.handle, &data, sizeof(data), vr::k_ulInvalidInputValueHandle) == vr::VRInputError_None;
+			state.active = valid && data.bActive;
+			if (state.active)
+			{
+				state.axis = glm::vec3(data.x, data.y, data.z);
+				resolveOrigin(state, data.activeOrigin);
+			}
+		}
+		break;
+		case ActionType_Pose:
+		case ActionType_Skeleton:
+		{
+			vr::InputPoseActionData_t data;
+			vr::EVRInputError poseError = poseSecondsFromNow < 0.0f ?
+				vr::VRInput()->GetPoseActionDataForNextFrame(action.handle, vr::TrackingUniverseStanding, &data, sizeof(data), vr::k_ulInvalidInputValueHandle) :
+				vr::VRInput()->GetPoseActionDataRelativeToNow(action.handle, vr::TrackingUniverseStanding, poseSecondsFromNow, &data, sizeof(data),
+					vr::k_ulInvalidInputValueHandle);
+			bool valid = poseError == vr::VRInputError_None;
+			state.active = valid && data.bActive;
+			state.poseValid = state.active && data.pose.bPoseIsValid;
+			if (state.poseValid)
+			{
+				state.pose = convertPoseMatrix(data.pose.mDeviceToAbsoluteTracking);
+				resolveOrigin(state, data.activeOrigin);
+			}
+		}
+		break;
+		default:
+			// vibration is output only, skeleton bones are read through their own interface
+			break;
+		}
+	}
+}
+
+void InputSystem::subscribeEvents(VREventBus& eventBus)
+{
+	eventBus.subscribe<InputSystem, &InputSystem::onBindingEvents>(vr::VREvent_ActionBindingReloaded, vr::VREvent_ActionBindingReloaded, this);
+	eventBus.subscribe<InputSystem, &InputSystem::onBindingEvents>(vr::VREvent_Input_BindingLoadSuccessful, vr::VREvent_Input_BindingLoadSuccessful, this);
+}
+
+void InputSystem::onBindingEvents()
+{
+	// new bindings can map the same origin handle to another device
+	for (ActionState& state : states)
+	{
+		state.origin = vr::k_ulInvalidInputValueHandle;
+		state.source = InputSource_Count;
+		state.poseDevice = vr::k_unTrackedDeviceIndexInvalid;
+	}
+}
+
+uint32_t InputSystem::findAction(const char* name) const
+{
+	for (size_t i = 0; i < actions.size(); ++i)
+	{
+		if (actions[i].name == name)
+		{
+			return (uint32_t)i;
+		}
+	}
+	return INVALID_ACTION;
+}
+
+void InputSystem::triggerHaptic(uint32_t action, float startSecondsFromNow, float duration, float frequency, float amplitude)
+{
+	if (actions[action].handle == vr::k_ulInvalidActionHandle)
+	{
+		return;
+	}
+
+	vr::EVRInputError inputError = vr::VRInput()->TriggerHapticVibrationAction(actions[action].handle, startSecondsFromNow, duration, frequency, amplitude,
+		vr::k_ulInvalidInputValueHandle);
+	if (inputError != vr::VRInputError_None)
+	{
+		printf("Failed to trigger haptic action %s, error: %d\n", actions[action].name.c_str(), inputError);
+	}
+}
+
+EActionType InputSystem::parseActionType(const std::string& type)
+{
+	if (type == "boolean") return ActionType_Boolean;
+	if (type == "vector1") return ActionType_Vector1;
+	if (type == "vector2") return ActionType_Vector2;
+	if (type == "vector3") return ActionType_Vector3;
+	if (type == "pose") return ActionType_Pose;
+	if (type == "skeleton") return ActionType_Skeleton;
+	if (type == "vibration") return ActionType_Vibration;
+	return ActionType_Unknown;
+}
+
+void InputSystem::resolveOrigin(ActionState& state, vr::VRInputValueHandle_t origin)
+{
+	// origins rarely change, so the device lookup only runs when one does
+	if (origin == state.origin)
+	{
+		return;
+	}
+	state.origin = origin;
+	state.source = InputSource_Count;
+	state.poseDevice = vr::k_unTrackedDeviceIndexInvalid;
+
+	vr::InputOriginInfo_t originInfo;
+	if (origin == vr::k_ulInvalidInputValueHandle
+		|| vr::VRInput()->GetOriginTrackedDeviceInfo(origin, &originInfo, sizeof(originInfo)) != vr::VRInputError_None)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < InputSource_Count; ++i)
+	{
+		if (originInfo.devicePath == sources[i])
+		{
+			state.source = (EInputSource)i;
+		}
+	}
+	state.poseDevice = originInfo.trackedDeviceIndex;
+}
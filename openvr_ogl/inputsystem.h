@@ -0,0 +1,117 @@
+#pragma once
+
+#include <openvr.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Actions the application queries directly, in the order they occupy the action table. Their
+// names and types come from the action manifest, which may declare further actions that can be
+// found by name with findAction().
+class VREventBus;
+
+enum EAction : uint32_t
+{
+	Action_Trigger,
+	Action_Trackpad,
+	Action_Grip,
+	Action_HandLeft,
+	Action_HandRight,
+	Action_HapticLeft,
+	Action_HapticRight,
+	Action_SkeletonLeft,
+	Action_SkeletonRight,
+	Action_Count
+};
+
+enum EInputSource : uint32_t
+{
+	InputSource_LeftHand,
+	InputSource_RightHand,
+	InputSource_Count
+};
+
+enum EActionType : uint8_t
+{
+	ActionType_Unknown,
+	ActionType_Boolean,
+	ActionType_Vector1,
+	ActionType_Vector2,
+	ActionType_Vector3,
+	ActionType_Pose,
+	ActionType_Skeleton,
+	ActionType_Vibration
+};
+
+// Input layer driven by the OpenVR action manifest. init() parses the manifest and resolves every
+// action, action set and input source into flat tables once, reporting any failure. update()
+// polls all actions in a single pass per frame into compact state, with press and release edges
+// computed there, so queries are plain array lookups by action index.
+class InputSystem
+{
+public:
+	static const uint32_t INVALID_ACTION = 0xFFFFFFFF;
+
+	// manifestPath is relative to the working directory
+	bool init(const char* manifestPath);
+	// listens for binding changes, after which the cached action origins are resolved again
+	void subscribeEvents(VREventBus& eventBus);
+	// poseSecondsFromNow predicts poses that far ahead; negative reads the poses predicted by the
+	// last WaitGetPoses
+	void update(float poseSecondsFromNow = -1.0f);
+
+	uint32_t findAction(const char* name) const;
+	uint32_t getActionCount() const { return (uint32_t)actions.size(); }
+	EActionType getActionType(uint32_t action) const { return actions[action].type; }
+	// for interfaces that take the action directly, such as skeletal bone data
+	vr::VRActionHandle_t getActionHandle(uint32_t action) const { return actions[action].handle; }
+
+	bool isActive(uint32_t action) const { return states[action].active; }
+	bool isDown(uint32_t action) const { return states[action].down; }
+	bool wasPressed(uint32_t action) const { return states[action].pressed; }
+	bool wasReleased(uint32_t action) const { return states[action].released; }
+	const glm::vec3& getAxis(uint32_t action) const { return states[action].axis; }
+	bool isPoseValid(uint32_t action) const { return states[action].poseValid; }
+	const glm::mat4& getPose(uint32_t action) const { return states[action].pose; }
+	// hand the action was last driven by, InputSource_Count if none
+	EInputSource getSource(uint32_t action) const { return states[action].source; }
+	// tracked device the action was last driven by, vr::k_unTrackedDeviceIndexInvalid if none
+	vr::TrackedDeviceIndex_t getPoseDevice(uint32_t action) const { return states[action].poseDevice; }
+	// input value handle of the hand's device path, e.g. for render model component states
+	vr::VRInputValueHandle_t getSourceHandle(EInputSource source) const { return sources[source]; }
+
+	void triggerHaptic(uint32_t action, float startSecondsFromNow, float duration, float frequency, float amplitude);
+
+private:
+	struct Action
+	{
+		std::string name;
+		vr::VRActionHandle_t handle = vr::k_ulInvalidActionHandle;
+		EActionType type = ActionType_Unknown;
+	};
+
+	struct ActionState
+	{
+		glm::mat4 pose = glm::mat4(1.0f);
+		glm::vec3 axis = glm::vec3(0.0f);
+		vr::VRInputValueHandle_t origin = vr::k_ulInvalidInputValueHandle;
+		vr::TrackedDeviceIndex_t poseDevice = vr::k_unTrackedDeviceIndexInvalid;
+		EInputSource source = InputSource_Count;
+		bool active = false;
+		bool down = false;
+		bool pressed = false;
+		bool released = false;
+		bool poseValid = false;
+	};
+
+	static EActionType parseActionType(const std::string& type);
+	void onBindingEvents();
+	void resolveOrigin(ActionState& state, vr::VRInputValueHandle_t origin);
+
+	std::vector<Action> actions;
+	std::vector<ActionState> states;
+	std::vector<vr::VRActiveActionSet_t> actionSets;
+	vr::VRInputValueHandle_t sources[InputSource_Count] = {};
+};
@@ -0,0 +1,167 @@
+#include "jobsystem.h"
+
+static thread_local const JobSystem* currentJobSystem = nullptr;
+static thread_local uint32_t currentWorkerIndex = 0;
+
+void JobSystem::init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::thread::hardware_concurrency();
+		workerCount = workerCount == 0 ? 1 : workerCount;
+	}
+
+	running = true;
+	currentJobSystem = this;
+	currentWorkerIndex = 0;
+
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		workers.push_back(new Worker());
+	}
+	for (uint32_t i = 1; i < workerCount; ++i)
+	{
+		workers[i]->thread = std::thread(&JobSystem::workerLoop, this, i);
+	}
+}
+
+void JobSystem::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+		running = false;
+	}
+	idleCondition.notify_all();
+
+	for (Worker* worker : workers)
+	{
+		if (worker->thread.joinable())
+		{
+			worker->thread.join();
+		}
+		delete worker;
+	}
+	workers.clear();
+
+	if (currentJobSystem == this)
+	{
+		currentJobSystem = nullptr;
+	}
+}
+
+void JobSystem::run(const Job& job)
+{
+	job.counter->value.fetch_add(1, std::memory_order_relaxed);
+
+	Worker& worker = *workers[getCurrentWorkerIndex()];
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tail - worker.head < QUEUE_CAPACITY)
+		{
+			worker.jobs[worker.tail % QUEUE_CAPACITY] = job;
+			worker.tail++;
+			pendingJobs.fetch_add(1, std::memory_order_release);
+			queued = true;
+		}
+	}
+
+	if (!queued)
+	{
+		// queue full, nobody would get to it sooner than we do
+		execute(job);
+		return;
+	}
+
+	// taking the idle lock orders the push before a sleeping worker re-checks pendingJobs
+	{
+		std::lock_guard<std::mutex> lock(idleMutex);
+	}
+	idleCondition.notify_one();
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	uint32_t workerIndex = getCurrentWorkerIndex();
+	while (counter.value.load(std::memory_order_acquire) != 0)
+	{
+		if (!runOne(workerIndex))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::workerLoop(uint32_t workerIndex)
+{
+	currentJobSystem = this;
+	currentWorkerIndex = workerIndex;
+
+	while (running)
+	{
+		if (!runOne(workerIndex))
+		{
+			std::unique_lock<std::mutex> lock(idleMutex);
+			idleCondition.wait(lock, [this]() { return pendingJobs.load(std::memory_order_acquire) > 0 || !running; });
+		}
+	}
+}
+
+bool JobSystem::runOne(uint32_t workerIndex)
+{
+	Job job;
+	bool found = pop(*workers[workerIndex], job);
+
+	uint32_t workerCount = (uint32_t)workers.size();
+	for (uint32_t i = 1; !found && i < workerCount; ++i)
+	{
+		found = steal(*workers[(workerIndex + i) % workerCount], job);
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	pendingJobs.fetch_sub(1, std::memory_order_relaxed);
+	execute(job);
+	return true;
+}
+
+bool JobSystem::pop(Worker& worker, Job& job)
+{
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.head == worker.tail)
+	{
+		return false;
+	}
+
+	worker.tail--;
+	job = worker.jobs[worker.tail % QUEUE_CAPACITY];
+	return true;
+}
+
+bool JobSystem::steal(Worker& worker, Job& job)
+{
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.head == worker.tail)
+	{
+		return false;
+	}
+
+	job = worker.jobs[worker.head % QUEUE_CAPACITY];
+	worker.head++;
+	return true;
+}
+
+void JobSystem::execute(const Job& job)
+{
+	job.function(job.data, job.begin, job.end);
+	job.counter->value.fetch_sub(1, std::memory_order_release);
+}
+
+uint32_t JobSystem::getCurrentWorkerIndex() const
+{
+	// threads the system doesn't own share the render thread's queue
+	return currentJobSystem == this ? currentWorkerIndex : 0;
+}
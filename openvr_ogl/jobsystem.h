@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <stdint.h>
+
+// Fork/join counter: incremented for every job run against it, decremented as each finishes
+struct JobCounter
+{
+	std::atomic<uint32_t> value{ 0 };
+};
+
+// Work-stealing job system. Every worker owns a deque: it pushes and pops its own jobs at the
+// back (LIFO, cache friendly) while idle workers steal from the front of the others'. The thread
+// that calls init() is worker 0 and executes jobs while it waits on a counter, so nothing blocks
+// the render thread that it could be doing itself.
+class JobSystem
+{
+public:
+	typedef void(*JobFunction)(void* data, uint32_t begin, uint32_t end);
+
+	struct Job
+	{
+		JobFunction function;
+		void* data;
+		uint32_t begin;
+		uint32_t end;
+		JobCounter* counter;
+	};
+
+	// workerCount includes the calling thread, 0 picks one per hardware thread
+	void init(uint32_t workerCount = 0);
+	void destroy();
+
+	void run(const Job& job);
+	void wait(JobCounter& counter);
+
+	// Calls function(begin, end) over [0, count) in chunks of grainSize and returns when all are
+	// done. Chunk boundaries only depend on count and grainSize, so writing results by index keeps
+	// the output identical for any worker count.
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t grainSize, const Function& function)
+	{
+		if (workers.size() <= 1 || count <= grainSize)
+		{
+			if (count > 0)
+				function(0, count);
+			return;
+		}
+
+		JobCounter counter;
+		for (uint32_t begin = 0; begin < count; begin += grainSize)
+		{
+			uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+			run({ &invoke<Function>, (void*)&function, begin, end, &counter });
+		}
+		wait(counter);
+	}
+
+	uint32_t getWorkerCount() const { return (uint32_t)workers.size(); }
+
+private:
+	static const uint32_t QUEUE_CAPACITY = 4096;
+
+	struct Worker
+	{
+		std::thread thread;
+		std::mutex mutex;
+		// ring buffer, [head, tail) holds the queued jobs
+		Job jobs[QUEUE_CAPACITY];
+		uint32_t head = 0;
+		uint32_t tail = 0;
+	};
+
+	template<typename Function>
+	static void invoke(void* data, uint32_t begin, uint32_t end)
+	{
+		(*(const Function*)data)(begin, end);
+	}
+
+	void workerLoop(uint32_t workerIndex);
+	bool runOne(uint32_t workerIndex);
+	bool pop(Worker& worker, Job& job);
+	bool steal(Worker& worker, Job& job);
+	void execute(const Job& job);
+	uint32_t getCurrentWorkerIndex() const;
+
+	std::vector<Worker*> workers;
+	std::atomic<bool> running{ false };
+	std::atomic<uint32_t> pendingJobs{ 0 };
+	std::mutex idleMutex;
+	std::condition_variable idleCondition;
+};
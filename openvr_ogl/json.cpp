@@ -0,0 +1,311 @@
+#include "json.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+class JsonParser
+{
+public:
+	JsonParser(const char* text) : cursor(text) {}
+
+	bool parseDocument(JsonValue& value, std::string& error)
+	{
+		skipWhitespace();
+		if (!parseValue(value, 0))
+		{
+			error = "line " + std::to_string(line) + ": " + message;
+			return false;
+		}
+		skipWhitespace();
+		if (*cursor)
+		{
+			error = "line " + std::to_string(line) + ": unexpected data after the document";
+			return false;
+		}
+		return true;
+	}
+
+private:
+	static const int MAX_DEPTH = 64;
+
+	bool fail(const char* reason)
+	{
+		message = reason;
+		return false;
+	}
+
+	void skipWhitespace()
+	{
+		while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == '\n')
+		{
+			line += *cursor == '\n';
+			cursor++;
+		}
+	}
+
+	bool consume(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if (strncmp(cursor, literal, length) != 0)
+		{
+			return false;
+		}
+		cursor += length;
+		return true;
+	}
+
+	bool parseValue(JsonValue& value, int depth)
+	{
+		if (depth > MAX_DEPTH)
+		{
+			return fail("nested too deeply");
+		}
+
+		switch (*cursor)
+		{
+		case '{':
+			return parseObject(value, depth);
+		case '[':
+			return parseArray(value, depth);
+		case '"':
+			value.type = JsonValue::Type_String;
+			return parseString(value.string);
+		case 't':
+		case 'f':
+			value.type = JsonValue::Type_Bool;
+			value.boolean = *cursor == 't';
+			return consume(value.boolean ? "true" : "false") || fail("invalid literal");
+		case 'n':
+			value.type = JsonValue::Type_Null;
+			return consume("null") || fail("invalid literal");
+		default:
+			return parseNumber(value);
+		}
+	}
+
+	bool parseObject(JsonValue& value, int depth)
+	{
+		value.type = JsonValue::Type_Object;
+		cursor++;
+		skipWhitespace();
+		if (*cursor == '}')
+		{
+			cursor++;
+			return true;
+		}
+
+		while (true)
+		{
+			skipWhitespace();
+			if (*cursor != '"')
+			{
+				return fail("expected a member name");
+			}
+			value.members.emplace_back();
+			JsonValue::Member& member = value.members.back();
+			if (!parseString(member.first))
+			{
+				return false;
+			}
+			skipWhitespace();
+			if (*cursor++ != ':')
+			{
+				return fail("expected ':' after a member name");
+			}
+			skipWhitespace();
+			if (!parseValue(member.second, depth + 1))
+			{
+				return false;
+			}
+			skipWhitespace();
+			char separator = *cursor++;
+			if (separator == '}')
+			{
+				return true;
+			}
+			if (separator != ',')
+			{
+				return fail("expected ',' or '}' in an object");
+			}
+		}
+	}
+
+	bool parseArray(JsonValue& value, int depth)
+	{
+		value.type = JsonValue::Type_Array;
+		cursor++;
+		skipWhitespace();
+		if (*cursor == ']')
+		{
+			cursor++;
+			return true;
+		}
+
+		while (true)
+		{
+			skipWhitespace();
+			value.elements.emplace_back();
+			if (!parseValue(value.elements.back(), depth + 1))
+			{
+				return false;
+			}
+			skipWhitespace();
+			char separator = *cursor++;
+			if (separator == ']')
+			{
+				return true;
+			}
+			if (separator != ',')
+			{
+				return fail("expected ',' or ']' in an array");
+			}
+		}
+	}
+
+	bool parseHex4(unsigned& code)
+	{
+		code = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			char c = *cursor++;
+			code <<= 4;
+			if (c >= '0' && c <= '9') code |= c - '0';
+			else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+			else return fail("invalid \\u escape");
+		}
+		return true;
+	}
+
+	static void appendUtf8(std::string& string, unsigned code)
+	{
+		if (code < 0x80)
+		{
+			string += (char)code;
+		}
+		else if (code < 0x800)
+		{
+			string += (char)(0xC0 | (code >> 6));
+			string += (char)(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			string += (char)(0xE0 | (code >> 12));
+			string += (char)(0x80 | ((code >> 6) & 0x3F));
+			string += (char)(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			string += (char)(0xF0 | (code >> 18));
+			string += (char)(0x80 | ((code >> 12) & 0x3F));
+			string += (char)(0x80 | ((code >> 6) & 0x3F));
+			string += (char)(0x80 | (code & 0x3F));
+		}
+	}
+
+	bool parseString(std::string& string)
+	{
+		cursor++;
+		while (*cursor != '"')
+		{
+			char c = *cursor++;
+			if (c == 0 || c == '\n')
+			{
+				return fail("unterminated string");
+			}
+			if (c != '\\')
+			{
+				string += c;
+				continue;
+			}
+
+			c = *cursor++;
+			switch (c)
+			{
+			case '"': string += '"'; break;
+			case '\\': string += '\\'; break;
+			case '/': string += '/'; break;
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u':
+			{
+				unsigned code;
+				if (!parseHex4(code))
+				{
+					return false;
+				}
+				// a high surrogate followed by a low one encodes a code point above the BMP; a lone
+				// surrogate becomes U+FFFD and whatever follows it is decoded on its own
+				if (code >= 0xD800 && code < 0xDC00)
+				{
+					const char* next = cursor;
+					unsigned low;
+					if (consume("\\u") && parseHex4(low) && low >= 0xDC00 && low < 0xE000)
+					{
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					else
+					{
+						code = 0xFFFD;
+						cursor = next;
+					}
+				}
+				else if (code >= 0xDC00 && code < 0xE000)
+				{
+					code = 0xFFFD;
+				}
+				appendUtf8(string, code);
+			}
+			break;
+			default:
+				return fail("invalid escape in string");
+			}
+		}
+		cursor++;
+		return true;
+	}
+
+	bool parseNumber(JsonValue& value)
+	{
+		if (*cursor != '-' && (*cursor < '0' || *cursor > '9'))
+		{
+			return fail(*cursor ? "unexpected character" : "unexpected end of document");
+		}
+
+		char* end = nullptr;
+		value.type = JsonValue::Type_Number;
+		value.number = strtod(cursor, &end);
+		if (end == cursor)
+		{
+			return fail("invalid number");
+		}
+		cursor = end;
+		return true;
+	}
+
+	const char* cursor;
+	int line = 1;
+	const char* message = "";
+};
+
+bool JsonValue::parse(const char* text, JsonValue& value, std::string& error)
+{
+	value = JsonValue();
+	JsonParser parser(text);
+	return parser.parseDocument(value, error);
+}
+
+const JsonValue* JsonValue::find(const char* key) const
+{
+	for (const Member& member : members)
+	{
+		if (member.first == key)
+		{
+			return &member.second;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal read-only JSON document, enough for the OpenVR manifests in asset/config
+class JsonValue
+{
+public:
+	enum EType
+	{
+		Type_Null, Type_Bool, Type_Number, Type_String, Type_Array, Type_Object
+	};
+
+	typedef std::pair<std::string, JsonValue> Member;
+
+	// Parses a whole document, on failure error holds the line and reason
+	static bool parse(const char* text, JsonValue& value, std::string& error);
+
+	EType getType() const { return type; }
+	bool isObject() const { return type == Type_Object; }
+	bool isArray() const { return type == Type_Array; }
+	bool isString() const { return type == Type_String; }
+
+	bool getBool() const { return boolean; }
+	double getNumber() const { return number; }
+	const std::string& getString() const { return string; }
+
+	// elements of an array
+	const std::vector<JsonValue>& getElements() const { return elements; }
+	// members of an object in document order
+	const std::vector<Member>& getMembers() const { return members; }
+	// member of an object by key, nullptr if this is not an object or has no such member
+	const JsonValue* find(const char* key) const;
+
+private:
+	friend class JsonParser;
+
+	EType type = Type_Null;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> elements;
+	std::vector<Member> members;
+};
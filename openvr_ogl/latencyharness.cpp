@@ -0,0 +1,274 @@
+#include "latencyharness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdio.h>
+
+static void decomposePose(const vr::HmdMatrix34_t& mat, glm::vec3& position, glm::quat& rotation)
+{
+	glm::mat3 basis(
+		mat.m[0][0], mat.m[1][0], mat.m[2][0],
+		mat.m[0][1], mat.m[1][1], mat.m[2][1],
+		mat.m[0][2], mat.m[1][2], mat.m[2][2]);
+	rotation = glm::normalize(glm::quat_cast(basis));
+	position = glm::vec3(mat.m[0][3], mat.m[1][3], mat.m[2][3]);
+}
+
+void LatencyHistogram::init(double bucketWidth, uint32_t bucketCount)
+{
+	this->bucketWidth = bucketWidth;
+	buckets.assign(bucketCount, 0);
+	reset();
+}
+
+void LatencyHistogram::reset()
+{
+	std::fill(buckets.begin(), buckets.end(), 0);
+	count = 0;
+	sum = 0.0;
+	max = 0.0;
+}
+
+void LatencyHistogram::add(double value)
+{
+	value = std::max(value, 0.0);
+	size_t bucket = std::min((size_t)(value / bucketWidth), buckets.size() - 1);
+	buckets[bucket]++;
+	max = count == 0 ? value : std::max(max, value);
+	sum += value;
+	count++;
+}
+
+double LatencyHistogram::getPercentile(double fraction) const
+{
+	uint32_t target = (uint32_t)std::ceil(count * fraction);
+	uint32_t seen = 0;
+	for (size_t i = 0; i < buckets.size(); ++i)
+	{
+		seen += buckets[i];
+		if (seen >= target && seen > 0)
+		{
+			return (i + 1) * bucketWidth;
+		}
+	}
+	return 0.0;
+}
+
+void LatencyHistogram::print(const char* name, const char* unit, bool showBuckets) const
+{
+	printf("%s: mean %.2f, p50 %.2f, p90 %.2f, p99 %.2f, max %.2f %s (%u frames)\n", name, getMean(),
+		getPercentile(0.5), getPercentile(0.9), getPercentile(0.99), getMax(), unit, count);
+	if (!showBuckets || count == 0)
+	{
+		return;
+	}
+
+	const int barWidth = 50;
+	uint32_t peak = *std::max_element(buckets.begin(), buckets.end());
+	for (size_t i = 0; i < buckets.size(); ++i)
+	{
+		if (buckets[i] == 0)
+		{
+			continue;
+		}
+		int bar = std::max(1, (int)((uint64_t)buckets[i] * barWidth / peak));
+		printf("  %7.2f%s %6u %.*s\n", i * bucketWidth, i + 1 == buckets.size() ? "+" : " ", buckets[i], bar,
+			"##################################################");
+	}
+}
+
+void OpenVRLatencySource::init(vr::IVRSystem* system)
+{
+	this->system = system;
+	float displayFrequency = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+	frameInterval = displayFrequency > 0.0f ? 1.0 / displayFrequency : 1.0 / 90.0;
+	vsyncToPhotons = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+}
+
+double OpenVRLatencySource::getTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool OpenVRLatencySource::getCurrentFrameIndex(uint32_t& frameIndex)
+{
+	vr::Compositor_FrameTiming timing = {};
+	timing.m_nSize = sizeof(timing);
+	if (!vr::VRCompositor()->GetFrameTiming(&timing, 0))
+	{
+		return false;
+	}
+	frameIndex = timing.m_nFrameIndex;
+	return true;
+}
+
+uint32_t OpenVRLatencySource::getFrameTimings(vr::Compositor_FrameTiming* timings, uint32_t count)
+{
+	timings[0].m_nSize = sizeof(vr::Compositor_FrameTiming);
+	return vr::VRCompositor()->GetFrameTimings(timings, count);
+}
+
+bool OpenVRLatencySource::getHmdPose(float secondsFromNow, vr::HmdMatrix34_t& pose)
+{
+	vr::TrackedDevicePose_t devicePose;
+	system->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, secondsFromNow, &devicePose, 1);
+	pose = devicePose.mDeviceToAbsoluteTracking;
+	return devicePose.bPoseIsValid;
+}
+
+LatencyHarness::LatencyHarness()
+{
+	motionToPhoton.init(0.5, 100);
+	submitToPhoton.init(0.5, 100);
+	photonTimeError.init(0.1, 100);
+	rotationError.init(0.05, 100);
+	positionError.init(0.1, 100);
+}
+
+void LatencyHarness::reset()
+{
+	motionToPhoton.reset();
+	submitToPhoton.reset();
+	photonTimeError.reset();
+	rotationError.reset();
+	positionError.reset();
+	resolvedFrames = lateFrames = unresolvedFrames = 0;
+}
+
+void LatencyHarness::beginFrame(LatencySource& source, double waitTime, float predictedSecondsToPhotons, const vr::HmdMatrix34_t& renderPose)
+{
+	samplePose(source);
+
+	current = nullptr;
+	uint32_t frameIndex = 0;
+	if (!source.getCurrentFrameIndex(frameIndex))
+	{
+		return;
+	}
+
+	// the slot reused is the oldest frame, which the compositor never reported
+	FrameRecord& frame = frames[frameCount++ % MAX_PENDING_FRAMES];
+	if (frame.pending)
+	{
+		unresolvedFrames++;
+	}
+	frame.frameIndex = frameIndex;
+	frame.waitTime = waitTime;
+	frame.poseTime = source.getTime();
+	frame.predictedPhotonTime = frame.poseTime + predictedSecondsToPhotons;
+	frame.submitTime = frame.poseTime;
+	decomposePose(renderPose, frame.position, frame.rotation);
+	frame.pending = true;
+	current = &frame;
+}
+
+void LatencyHarness::endFrame(LatencySource& source)
+{
+	if (current)
+	{
+		current->submitTime = source.getTime();
+		current = nullptr;
+	}
+	// a second sample per frame keeps the interpolated poses close to the measured motion
+	samplePose(source);
+	resolve(source);
+}
+
+void LatencyHarness::samplePose(LatencySource& source)
+{
+	vr::HmdMatrix34_t pose;
+	if (!source.getHmdPose(0.0f, pose))
+	{
+		return;
+	}
+
+	PoseSample& sample = poses[poseCount++ % POSE_HISTORY];
+	sample.time = source.getTime();
+	decomposePose(pose, sample.position, sample.rotation);
+}
+
+bool LatencyHarness::interpolatePose(double time, glm::vec3& position, glm::quat& rotation) const
+{
+	// newest first, find the two samples around the time
+	uint32_t available = poseCount < POSE_HISTORY ? poseCount : POSE_HISTORY;
+	for (uint32_t i = 1; i < available; ++i)
+	{
+		const PoseSample& after = poses[(poseCount - i) % POSE_HISTORY];
+		const PoseSample& before = poses[(poseCount - i - 1) % POSE_HISTORY];
+		if (before.time <= time && time <= after.time)
+		{
+			float t = after.time > before.time ? (float)((time - before.time) / (after.time - before.time)) : 0.0f;
+			position = glm::mix(before.position, after.position, t);
+			rotation = glm::slerp(before.rotation, after.rotation, t);
+			return true;
+		}
+	}
+	return false;
+}
+
+void LatencyHarness::resolve(LatencySource& source)
+{
+	uint32_t count = source.getFrameTimings(timings, MAX_PENDING_FRAMES);
+	double latestPose = poseCount ? poses[(poseCount - 1) % POSE_HISTORY].time : 0.0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const vr::Compositor_FrameTiming& timing = timings[i];
+		if (timing.m_nNumFramePresents == 0)
+		{
+			continue;
+		}
+
+		FrameRecord* frame = nullptr;
+		for (FrameRecord& candidate : frames)
+		{
+			if (candidate.pending && candidate.frameIndex == timing.m_nFrameIndex)
+			{
+				frame = &candidate;
+				break;
+			}
+		}
+		if (!frame)
+		{
+			continue;
+		}
+
+		// compositor time plus offset gives source time, anchored where WaitGetPoses returned
+		double clockOffset = frame->waitTime - (timing.m_flSystemTimeInSeconds + timing.m_flNewPosesReadyMs / 1000.0);
+		uint32_t vsyncs = std::max(timing.m_nNumVSyncsToFirstView, 1u);
+		double photonTime = timing.m_flSystemTimeInSeconds + vsyncs * source.getFrameInterval() + source.getVsyncToPhotons() + clockOffset;
+		if (photonTime > latestPose)
+		{
+			// the pose at photon time has not been measured yet
+			continue;
+		}
+
+		glm::vec3 position;
+		glm::quat rotation;
+		if (interpolatePose(photonTime, position, rotation))
+		{
+			float dot = std::min(std::abs(glm::dot(rotation, frame->rotation)), 1.0f);
+			rotationError.add(glm::degrees(2.0f * std::acos(dot)));
+			positionError.add(glm::length(position - frame->position) * 1000.0);
+		}
+		motionToPhoton.add((photonTime - frame->poseTime) * 1000.0);
+		submitToPhoton.add((photonTime - frame->submitTime) * 1000.0);
+		photonTimeError.add(std::abs(photonTime - frame->predictedPhotonTime) * 1000.0);
+		if (timing.m_nNumMisPresented > 0 || vsyncs > 1)
+		{
+			lateFrames++;
+		}
+		resolvedFrames++;
+		frame->pending = false;
+	}
+}
+
+void LatencyHarness::print(bool showBuckets) const
+{
+	printf("Latency: %u frames resolved, %u displayed late, %u never reported\n", resolvedFrames, lateFrames, unresolvedFrames);
+	motionToPhoton.print("  motion-to-photon", "ms", showBuckets);
+	submitToPhoton.print("  submit-to-photon", "ms", showBuckets);
+	photonTimeError.print("  photon time error", "ms", showBuckets);
+	rotationError.print("  rotation prediction error", "deg", showBuckets);
+	positionError.print("  position prediction error", "mm", showBuckets);
+}
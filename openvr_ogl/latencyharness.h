@@ -0,0 +1,137 @@
+#pragma once
+
+#include <openvr.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+// Fixed width buckets from 0, values past the last bucket are counted in it
+class LatencyHistogram
+{
+public:
+	void init(double bucketWidth, uint32_t bucketCount);
+	void reset();
+	void add(double value);
+
+	uint32_t getCount() const { return count; }
+	double getMean() const { return count ? sum / count : 0.0; }
+	double getMax() const { return max; }
+	// upper edge of the bucket holding the given fraction of the values
+	double getPercentile(double fraction) const;
+	// one line summary, with showBuckets one more line per non-empty bucket
+	void print(const char* name, const char* unit, bool showBuckets) const;
+
+private:
+	std::vector<uint32_t> buckets;
+	double bucketWidth = 1.0;
+	uint32_t count = 0;
+	double sum = 0.0;
+	double max = 0.0;
+};
+
+// What the harness needs from a VR runtime: the real one through OpenVR, or a simulation
+class LatencySource
+{
+public:
+	virtual ~LatencySource() {}
+
+	// seconds on the clock all stamps are taken with
+	virtual double getTime() = 0;
+	virtual double getFrameInterval() = 0;
+	virtual double getVsyncToPhotons() = 0;
+	// compositor index of the frame being rendered, valid after WaitGetPoses
+	virtual bool getCurrentFrameIndex(uint32_t& frameIndex) = 0;
+	// timing of the most recent frames, oldest first, returns how many were filled
+	virtual uint32_t getFrameTimings(vr::Compositor_FrameTiming* timings, uint32_t count) = 0;
+	// the HMD pose predicted secondsFromNow ahead, 0 for where it is now
+	virtual bool getHmdPose(float secondsFromNow, vr::HmdMatrix34_t& pose) = 0;
+};
+
+class OpenVRLatencySource : public LatencySource
+{
+public:
+	void init(vr::IVRSystem* system);
+
+	double getTime() override;
+	double getFrameInterval() override { return frameInterval; }
+	double getVsyncToPhotons() override { return vsyncToPhotons; }
+	bool getCurrentFrameIndex(uint32_t& frameIndex) override;
+	uint32_t getFrameTimings(vr::Compositor_FrameTiming* timings, uint32_t count) override;
+	bool getHmdPose(float secondsFromNow, vr::HmdMatrix34_t& pose) override;
+
+private:
+	vr::IVRSystem* system = nullptr;
+	double frameInterval = 1.0 / 90.0;
+	double vsyncToPhotons = 0.0;
+};
+
+// Measures motion-to-photon latency. beginFrame() stamps the frame when its poses are final and
+// records the pose it is rendered with and the photon time that pose was predicted for, endFrame()
+// stamps the submit. Once the compositor reports when the frame was first displayed, the frame is
+// resolved against the HMD poses actually measured around that time:
+//   motion-to-photon  photon time - pose sample time
+//   photon time error actual - predicted photon time
+//   pose error        rendered pose vs. measured pose at photon time
+// Compositor times are mapped onto the source clock through the time new poses were ready, so
+// the measured pose history and the frame timings can be compared.
+class LatencyHarness
+{
+public:
+	// frames kept until the compositor reports them, older ones are counted as unresolved
+	static const uint32_t MAX_PENDING_FRAMES = 16;
+	static const uint32_t POSE_HISTORY = 256;
+
+	LatencyHarness();
+
+	// waitTime is when WaitGetPoses returned, the poses may have been sampled later than that
+	void beginFrame(LatencySource& source, double waitTime, float predictedSecondsToPhotons, const vr::HmdMatrix34_t& renderPose);
+	void endFrame(LatencySource& source);
+
+	void reset();
+	// one line per measure, showBuckets adds the histograms
+	void print(bool showBuckets) const;
+
+	const LatencyHistogram& getMotionToPhoton() const { return motionToPhoton; }
+
+private:
+	struct FrameRecord
+	{
+		uint32_t frameIndex = 0;
+		double waitTime = 0.0;
+		double poseTime = 0.0;
+		double predictedPhotonTime = 0.0;
+		double submitTime = 0.0;
+		glm::vec3 position;
+		glm::quat rotation;
+		bool pending = false;
+	};
+
+	struct PoseSample
+	{
+		double time;
+		glm::vec3 position;
+		glm::quat rotation;
+	};
+
+	void samplePose(LatencySource& source);
+	bool interpolatePose(double time, glm::vec3& position, glm::quat& rotation) const;
+	void resolve(LatencySource& source);
+
+	FrameRecord frames[MAX_PENDING_FRAMES];
+	uint32_t frameCount = 0;
+	FrameRecord* current = nullptr;
+	PoseSample poses[POSE_HISTORY];
+	uint32_t poseCount = 0;
+	vr::Compositor_FrameTiming timings[MAX_PENDING_FRAMES];
+
+	LatencyHistogram motionToPhoton;
+	LatencyHistogram submitToPhoton;
+	LatencyHistogram photonTimeError;
+	LatencyHistogram rotationError;
+	LatencyHistogram positionError;
+	uint32_t resolvedFrames = 0;
+	uint32_t lateFrames = 0;
+	uint32_t unresolvedFrames = 0;
+};
@@ -9,10 +9,33 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <iostream>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
 
 #include "shader.h"
 #include "camera.h"
 #include "openvrwrapper.h"
+#include "glstatecache.h"
+#include "renderqueue.h"
+#include "culling.h"
+#include "jobsystem.h"
+#include "transformsystem.h"
+#include "eyerendertarget.h"
+#include "foveatedeyetarget.h"
+#include "mirrorwindow.h"
+#include "streambuffer.h"
+#include "frameallocator.h"
+#include "gputimer.h"
+#include "handrenderer.h"
+#include "rendermodelrenderer.h"
+#include "simulatedruntime.h"
+#include "drawlist.h"
+#include "stressscene.h"
+#include "overdrawmonitor.h"
+#include "clusteredlighting.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -24,6 +47,37 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 400;
 const unsigned int VR_WIDTH = 1996;
 const unsigned int VR_HEIGHT = 2216;
+const unsigned int MSAA_SAMPLES = 4;
+// eye textures cycled through so a frame never renders into one the compositor is still reading
+const unsigned int EYE_SWAPCHAIN_LENGTH = 3;
+// per-frame GPU data streamed through a buffer of this many bytes per frame in flight, grows if needed
+const size_t STREAM_BUFFER_FRAME_SIZE = 1 << 20;
+// transient per-frame lists come from an arena of this size, two of them alternate between frames
+const size_t FRAME_ARENA_SIZE = 4 << 20;
+// frames after startup are expected to make no heap allocations; one that does fails the run with a
+// non-zero exit code (checked with TRACK_HEAP_ALLOCATIONS, on in debug builds)
+const uint32_t HEAP_CHECK_WARMUP_FRAMES = 100;
+// fixed foveation: render target regions needing less than this fraction of the peak lens
+// resolution are drawn at reduced resolution; higher values trade quality for speed
+const bool FOVEATED_RENDERING = false;
+const float FOVEATION_THRESHOLD = 0.7f;
+// what the desktop window shows of the HMD view and how often, in Hz
+const EMirrorMode MIRROR_MODE = MirrorMode_BothEyes;
+const float MIRROR_RATE = 30.0f;
+// resolution of the spectator view relative to the desktop window, for MirrorMode_Spectator
+const float SPECTATOR_SCALE = 0.5f;
+// delay each frame's start after WaitGetPoses so poses are sampled as late as the frame's measured
+// cost allows, see FramePacer
+const bool FRAME_PACING = true;
+// per-frame motion-to-photon measurement, printed with the stats
+const bool LATENCY_MEASUREMENT = false;
+// materials marked DepthPrepass_Auto get a depth-only pre-pass while the measured overdraw, depth
+// test passes per sample of the left eye, is above this
+const float DEPTH_PREPASS_OVERDRAW = 2.0f;
+// colored point lights circling the cubes, shaded per cluster, see ClusteredLighting
+const uint32_t POINT_LIGHT_COUNT = 64;
+const glm::vec3 LIGHT_CENTER(0.0f, 0.0f, -6.0f);
+const float LIGHT_SPREAD = 2.0f;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -34,6 +88,9 @@ bool firstMouse = true;
 // timing
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
+float lastStatsTime = 0.0f;
+HeapAllocationCheck heapCheck(HEAP_CHECK_WARMUP_FRAMES);
+const float STATS_INTERVAL = 5.0f;
 
 // world space positions of our cubes
 glm::vec3 cubePositions[] = {
@@ -52,42 +109,557 @@ glm::vec3 cubePositions[] = {
 unsigned int VBO, VAO;
 unsigned int texture;
 OpenVRWrapper openVRWrapper;
-Shader shader;
+GLStateCache glState;
+RenderQueue renderQueue;
+TransformSystem transformSystem;
+TransformHandle hmdTransform;
+TransformHandle controllerTransform[2];
+// transforms of everything drawn; the first staticRenderableCount never move and live in the BVH
+std::vector<TransformHandle> renderables;
+uint32_t staticRenderableCount = 0;
+BVH sceneBVH;
+FrameAllocator frameAllocator;
+FrameVector<uint32_t> visibleObjects(frameAllocator.getArena());
+std::vector<std::vector<uint32_t>> subtreeVisibleObjects;
+JobSystem jobSystem;
+EyeRenderTarget eyeRenderTarget[2];
+FoveatedEyeTarget foveatedEyeTarget[2];
+MirrorWindow mirrorWindow;
+EyeRenderTarget spectatorTarget;
+StreamBuffer streamBuffer;
+GpuTimer frameGpuTimer;
+HandRenderer handRenderer;
+RenderModelRenderer renderModelRenderer;
+ShaderVariants simpleShaderVariants;
+ShaderVariants depthShaderVariants;
+OverdrawMonitor overdrawMonitor;
+ClusteredLighting clusteredLighting;
+uint32_t shaderFeatures = ShaderFeature_Specular | ShaderFeature_ClusteredLighting;
 
-void renderScene(const glm::mat4& eyeViewProjMat)
+// static cubes go into the BVH once; small cubes attached to the controllers follow their poses
+void buildScene()
+{
+	TransformHandle sceneRoot = transformSystem.create();
+	for (unsigned int i = 0; i < 10; i++)
+	{
+		float angle = 20.0f * i;
+		glm::quat rotation = glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+		renderables.push_back(transformSystem.create(sceneRoot, cubePositions[i], rotation));
+	}
+	staticRenderableCount = (uint32_t)renderables.size();
+
+	hmdTransform = transformSystem.create();
+	for (int i = 0; i < 2; ++i)
+	{
+		controllerTransform[i] = transformSystem.create();
+		renderables.push_back(transformSystem.create(controllerTransform[i], glm::vec3(0.0f, 0.0f, -0.1f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.05f)));
+	}
+	transformSystem.update();
+
+	std::vector<AABB> sceneBounds;
+	for (uint32_t i = 0; i < staticRenderableCount; ++i)
+	{
+		sceneBounds.push_back(AABB::fromTransformedUnitCube(transformSystem.getWorldMatrix(renderables[i])));
+	}
+	sceneBVH.build(sceneBounds);
+}
+
+// feed this frame's tracked poses into the hierarchy; only what moved gets recomputed
+void updateSceneTransforms()
+{
+	transformSystem.setLocalRigidMatrix(hmdTransform, openVRWrapper.getHmdModelMat());
+	for (int i = 0; i < 2; ++i)
+	{
+		transformSystem.setLocalRigidMatrix(controllerTransform[i], openVRWrapper.getControllerModelMat(i));
+	}
+	// stays on this thread until enough of the scene moves to be worth splitting up
+	transformSystem.update(&jobSystem);
+}
+
+// lightCount lights on rings of growing radius around center, each ring turning the other way
+void updateLights(uint32_t lightCount, const glm::vec3& center, float spread, float time)
+{
+	clusteredLighting.clearLights();
+	for (uint32_t i = 0; i < lightCount; ++i)
+	{
+		float ring = (float)(i % 4 + 1);
+		float angle = 6.2831853f * i / lightCount + time * (i % 2 == 0 ? 0.5f : -0.5f) / ring;
+		float hue = 6.2831853f * i / lightCount;
+		PointLight light;
+		light.position = center + glm::vec3(std::cos(angle) * ring * spread, std::sin(angle * 3.0f) * spread, std::sin(angle) * ring * spread);
+		light.radius = 2.0f * spread;
+		light.color = 0.5f + 0.5f * glm::vec3(std::cos(hue), std::cos(hue - 2.0943951f), std::cos(hue + 2.0943951f));
+		light.intensity = 2.0f;
+		clusteredLighting.addLight(light);
+	}
+}
+
+// cull against both eyes at once and submit the survivors; the sorted queue is shared by both eyes
+void buildRenderQueue(const glm::mat4& leftViewProjMat, const glm::mat4& rightViewProjMat, const glm::vec3& viewPosition)
+{
+	Frustum frustum = Frustum::combineStereo(leftViewProjMat, rightViewProjMat);
+	// a fresh list from this frame's arena, reserved for every object so it never grows
+	visibleObjects = FrameVector<uint32_t>(frameAllocator.getArena());
+	visibleObjects.reserve(renderables.size());
+	cullScene(jobSystem, sceneBVH, frustum, subtreeVisibleObjects, visibleObjects);
+	for (uint32_t i = staticRenderableCount; i < renderables.size(); ++i)
+	{
+		if (frustum.intersects(AABB::fromTransformedUnitCube(transformSystem.getWorldMatrix(renderables[i]))))
+		{
+			visibleObjects.push_back(i);
+		}
+	}
+
+	Shader& shader = simpleShaderVariants.get(shaderFeatures);
+	// the variant can change at runtime; registering it again only looks the material up
+	DrawPacket packet = { shader.ID, VAO, texture, 0, 36, 0, DepthPrepass_Auto, 0, renderQueue.registerMaterial(shader.ID, texture) };
+	generateDrawPackets(jobSystem, renderQueue, visibleObjects, renderables, transformSystem, packet, viewPosition);
+
+	renderQueue.sort();
+	renderQueue.upload(streamBuffer);
+}
+
+// every tracked device with a pose and a render model, grouped into one instanced draw per model
+// by the renderer; the HMD is skipped, from inside it would only block the view
+void queueTrackedDeviceModels()
+{
+	for (vr::TrackedDeviceIndex_t device = 0; device < vr::k_unMaxTrackedDeviceCount; ++device)
+	{
+		if (device == vr::k_unTrackedDeviceIndex_Hmd || !openVRWrapper.isDevicePoseValid(device) || openVRWrapper.getDeviceRenderModel(device)[0] == 0)
+		{
+			continue;
+		}
+		renderModelRenderer.add(openVRWrapper.getDeviceRenderModel(device), openVRWrapper.getDeviceInputPath(device), openVRWrapper.getDeviceModelMat(device));
+	}
+}
+
+// measures culling and draw packet generation over a large random scene for 1..N workers
+// ----------------------------------------------------------------------------------------
+void runJobScalingBenchmark()
+{
+	const uint32_t objectCount = 200000;
+	const int iterations = 50;
+
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	TransformSystem transforms;
+	std::vector<TransformHandle> objects;
+	for (uint32_t i = 0; i < objectCount; ++i)
+	{
+		objects.push_back(transforms.create(INVALID_TRANSFORM, glm::vec3(position(random), position(random), position(random))));
+	}
+	transforms.update();
+
+	std::vector<AABB> bounds;
+	for (TransformHandle object : objects)
+	{
+		bounds.push_back(AABB::fromTransformedUnitCube(transforms.getWorldMatrix(object)));
+	}
+
+	BVH bvh;
+	bvh.build(bounds);
+	glm::mat4 proj = glm::perspective(glm::radians(110.0f), 0.9f, 0.1f, 100.0f);
+	Frustum frustum = Frustum::fromViewProjMat(proj);
+	DrawPacket packet = { 1, 1, 1, 0, 36, 0, DepthPrepass_Never, 0, 0 };
+
+	uint32_t maxWorkers = std::max(1u, std::thread::hardware_concurrency());
+	double baseline = 0.0;
+	printf("workers, ms/frame, speedup (%u objects)\n", objectCount);
+	for (uint32_t workers = 1; workers <= maxWorkers; ++workers)
+	{
+		JobSystem jobs;
+		jobs.init(workers);
+		FrameAllocator frames;
+		frames.init(objectCount * sizeof(uint32_t) + 4096);
+		RenderQueue queue;
+		packet.material = queue.registerMaterial(packet.program, packet.texture);
+		std::vector<std::vector<uint32_t>> subtreeVisible;
+		FrameVector<uint32_t> visible(frames.getArena());
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			frames.beginFrame();
+			visible = FrameVector<uint32_t>(frames.getArena());
+			visible.reserve(objectCount);
+			cullScene(jobs, bvh, frustum, subtreeVisible, visible);
+			generateDrawPackets(jobs, queue, visible, objects, transforms, packet, glm::vec3(0.0f));
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+		baseline = workers == 1 ? ms : baseline;
+		printf("%u, %.3f, %.2fx (%zu visible)\n", workers, ms, baseline / ms, visible.size());
+
+		frames.destroy();
+		jobs.destroy();
+	}
+}
+
+void clearScene(uint32_t width, uint32_t height)
 {
 	// render
 		// ------
 	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glState.depthMask(true);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glViewport(0, 0, VR_WIDTH, VR_HEIGHT);
-
-	// bind textures on corresponding texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glState.viewport(0, 0, width, height);
+	glState.setEnabled(GL_DEPTH_TEST, true);
+}
 
-	// activate shader
-	shader.use();
-	shader.setMat4("viewProj", eyeViewProjMat);
-	shader.setVec3("cameraPosition", camera.Position);
+void renderScene(uint32_t eye, const glm::mat4& eyeViewProjMat, uint32_t width, uint32_t height, OverdrawMonitor* overdraw = nullptr)
+{
+	clearScene(width, height);
 
 	// render boxes
-	glBindVertexArray(VAO);
-	for (unsigned int i = 0; i < 10; i++)
+	renderQueue.execute(glState, eye, eyeViewProjMat, camera.Position, overdraw);
+	renderModelRenderer.draw(glState, eyeViewProjMat, camera.Position);
+	handRenderer.draw(glState, eyeViewProjMat, camera.Position);
+}
+
+// Third person view from the desktop camera. It replays the render queue built for the HMD, so it
+// costs no extra culling or sorting, but only shows what is in or near the HMD's view. The point
+// lights are looked up in the HMD's clusters as well, so away from its view some go missing.
+void renderSpectator()
+{
+	float aspect = (float)spectatorTarget.getRenderWidth() / (float)spectatorTarget.getRenderHeight();
+	glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
+	glState.bindFramebuffer(GL_FRAMEBUFFER, spectatorTarget.getRenderFramebuffer());
+	// runs after submit, where the compositor may have replaced the lighting bindings
+	clusteredLighting.bind(glState, streamBuffer);
+	renderScene(0, projection * camera.GetViewMatrix(), spectatorTarget.getRenderWidth(), spectatorTarget.getRenderHeight());
+	spectatorTarget.resolve(glState);
+}
+
+// draws both foveation layers of one eye and composes them into its submitted texture; overdraw
+// is measured in the center layer, the periphery is partly masked
+void renderFoveatedEye(uint32_t eye, const glm::mat4& eyeViewProjMat, FoveatedEyeTarget& target, OverdrawMonitor* overdraw = nullptr)
+{
+	for (int i = 0; i < FoveatedEyeTarget::Layer_Count; ++i)
 	{
-		// calculate the model matrix for each object and pass it to shader before drawing
-		glm::mat4 model = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-		model = glm::translate(model, cubePositions[i]);
-		float angle = 20.0f * i;
-		model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-		shader.setMat4("model", model);
+		FoveatedEyeTarget::ELayer layer = (FoveatedEyeTarget::ELayer)i;
+		EyeRenderTarget& layerTarget = target.getLayer(layer);
+		glState.bindFramebuffer(GL_FRAMEBUFFER, layerTarget.getRenderFramebuffer());
+		clearScene(layerTarget.getRenderWidth(), layerTarget.getRenderHeight());
+		if (layer == FoveatedEyeTarget::Layer_Periphery)
+		{
+			target.maskPeriphery(glState);
+		}
+		else if (overdraw)
+		{
+			overdraw->setTargetSamples((uint64_t)layerTarget.getRenderWidth() * layerTarget.getRenderHeight() * layerTarget.getSamples());
+		}
+		renderQueue.execute(glState, eye, target.getLayerCrop(layer) * eyeViewProjMat, camera.Position,
+			layer == FoveatedEyeTarget::Layer_Center ? overdraw : nullptr);
+		renderModelRenderer.draw(glState, target.getLayerCrop(layer) * eyeViewProjMat, camera.Position);
+		handRenderer.draw(glState, target.getLayerCrop(layer) * eyeViewProjMat, camera.Position);
+	}
+	target.compose(glState);
+}
 
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+// runs the latency harness against a simulated runtime, no headset or window needed
+// ----------------------------------------------------------------------------------------
+void runLatencySimulation()
+{
+	const int frames = 5000;
+
+	SimulatedRuntime runtime;
+	LatencyHarness harness;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		vr::HmdMatrix34_t renderPose;
+		float predictedSecondsToPhotons = 0.0f;
+		runtime.waitGetPoses(renderPose, predictedSecondsToPhotons);
+		harness.beginFrame(runtime, runtime.getTime(), predictedSecondsToPhotons, renderPose);
+		runtime.advance(runtime.sampleCpuTime());
+		runtime.submit(runtime.sampleGpuTime());
+		harness.endFrame(runtime);
 	}
+	printf("%d simulated frames at %.0f Hz\n", frames, 1.0 / runtime.getFrameInterval());
+	harness.print(true);
 }
 
-int main()
+// compares the GPU cost of MSAA eye targets against supersampling with a fixed stereo view
+// ----------------------------------------------------------------------------------------
+void runMsaaBenchmark()
 {
+	struct Config
+	{
+		const char* name;
+		uint32_t samples;
+		float renderScale;
+	};
+	const Config configs[] = {
+		{ "no AA", 1, 1.0f },
+		{ "MSAA 2x", 2, 1.0f },
+		{ "MSAA 4x", 4, 1.0f },
+		{ "MSAA 8x", 8, 1.0f },
+		{ "supersampling 2x pixels", 1, 1.4142f },
+		{ "supersampling 4x pixels", 1, 2.0f },
+	};
+	const int warmupFrames = 10;
+	const int frames = 100;
+
+	glm::mat4 proj = glm::perspective(glm::radians(100.0f), (float)VR_WIDTH / (float)VR_HEIGHT, 0.1f, 100.0f);
+	glm::mat4 view = camera.GetViewMatrix();
+	glm::mat4 eyeViewProjMat[2] = {
+		proj * glm::translate(glm::mat4(1.0f), glm::vec3(0.032f, 0.0f, 0.0f)) * view,
+		proj * glm::translate(glm::mat4(1.0f), glm::vec3(-0.032f, 0.0f, 0.0f)) * view
+	};
+
+	GpuTimer timer;
+	timer.init();
+	for (const Config& config : configs)
+	{
+		EyeRenderTarget target[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			target[i].init(VR_WIDTH, VR_HEIGHT, config.samples, config.renderScale);
+		}
+		glState.invalidate();
+
+		double totalMs = 0.0;
+		for (int frame = 0; frame < warmupFrames + frames; ++frame)
+		{
+			timer.begin();
+			streamBuffer.beginFrame(glState);
+			frameAllocator.beginFrame();
+			buildRenderQueue(eyeViewProjMat[0], eyeViewProjMat[1], camera.Position);
+			clusteredLighting.build(streamBuffer, view, eyeViewProjMat[0], eyeViewProjMat[1]);
+			streamBuffer.commit();
+			clusteredLighting.bind(glState, streamBuffer);
+			for (int i = 0; i < 2; ++i)
+			{
+				glState.bindFramebuffer(GL_FRAMEBUFFER, target[i].getRenderFramebuffer());
+				renderScene(i, eyeViewProjMat[i], target[i].getRenderWidth(), target[i].getRenderHeight());
+				target[i].resolve(glState);
+			}
+			streamBuffer.endFrame();
+			timer.end();
+			glFinish();
+
+			double ms = 0.0;
+			if (timer.getLastResult(ms) && frame >= warmupFrames)
+			{
+				totalMs += ms;
+			}
+		}
+		printf("%s: %u*%u render size, %.3f ms GPU per stereo frame\n", config.name,
+			target[0].getRenderWidth(), target[0].getRenderHeight(), totalMs / frames);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			target[i].destroy();
+		}
+	}
+	timer.destroy();
+}
+
+// renders a procedurally populated scene at several sizes along a scripted HMD path from the
+// simulated runtime, and writes per-frame CPU and GPU times, draw calls and culling to a CSV file
+// ----------------------------------------------------------------------------------------
+void runStressBenchmark(int argc, char** argv)
+{
+	std::vector<uint32_t> instanceCounts = { 1000, 10000, 100000, 1000000 };
+	uint32_t meshCount = 4;
+	uint32_t materialCount = 16;
+	uint32_t lightCount = POINT_LIGHT_COUNT;
+	int frames = 600;
+	const char* csvPath = "stress.csv";
+	const int warmupFrames = 30;
+	// walking pace along the camera path, in meters per second
+	const float pathSpeed = 3.0f;
+
+	for (int i = 2; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--instances") == 0)
+		{
+			// comma separated list of scene sizes
+			instanceCounts.clear();
+			for (const char* count = argv[i + 1]; *count; )
+			{
+				char* end = nullptr;
+				uint32_t value = (uint32_t)strtoul(count, &end, 10);
+				if (end == count)
+				{
+					break;
+				}
+				instanceCounts.push_back(value);
+				count = *end == ',' ? end + 1 : end;
+			}
+		}
+		else if (strcmp(argv[i], "--meshes") == 0)
+		{
+			meshCount = (uint32_t)atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "--materials") == 0)
+		{
+			materialCount = (uint32_t)atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "--lights") == 0)
+		{
+			lightCount = (uint32_t)atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "--frames") == 0)
+		{
+			frames = atoi(argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "--csv") == 0)
+		{
+			csvPath = argv[i + 1];
+		}
+		else
+		{
+			printf("Unknown stress benchmark option %s\n", argv[i]);
+		}
+	}
+
+	FILE* csv = fopen(csvPath, "w");
+	if (!csv)
+	{
+		printf("Failed to open %s\n", csvPath);
+		return;
+	}
+	fprintf(csv, "instances,meshes,materials,lights,frame,cpu_ms,gpu_ms,draw_calls,prepass_draws,overdraw,visible,culled,light_entries,vsyncs\n");
+
+	// the visible list is reserved for every instance, so the arena has to hold that many
+	uint32_t maxInstances = instanceCounts.empty() ? 0 : *std::max_element(instanceCounts.begin(), instanceCounts.end());
+	frameAllocator.destroy();
+	frameAllocator.init(std::max(FRAME_ARENA_SIZE, maxInstances * sizeof(uint32_t) + 4096));
+
+	glm::mat4 proj = glm::perspective(glm::radians(100.0f), (float)VR_WIDTH / (float)VR_HEIGHT, 0.1f, 100.0f);
+	EyeRenderTarget target[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		target[i].init(VR_WIDTH, VR_HEIGHT, MSAA_SAMPLES);
+	}
+	GpuTimer timer;
+	timer.init();
+
+	printf("instances, build ms, CPU ms (p99), GPU ms (p99), draws, visible, late frames\n");
+	for (uint32_t instanceCount : instanceCounts)
+	{
+		StressScene scene;
+		auto buildStart = std::chrono::high_resolution_clock::now();
+		// the textures of the previous scene are deleted, and their names may come back
+		renderQueue.clearMaterials();
+		scene.build(renderQueue, instanceCount, meshCount, materialCount, simpleShaderVariants, shaderFeatures);
+		double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+		glState.invalidate();
+
+		SimulatedRuntime runtime;
+		runtime.setPath(scene.getCameraPath(), pathSpeed);
+		std::vector<double> cpuTimes;
+		std::vector<double> gpuTimes;
+		double totalDraws = 0.0;
+		double totalVisible = 0.0;
+		uint32_t lateFrames = 0;
+		for (int frame = 0; frame < warmupFrames + frames; ++frame)
+		{
+			vr::HmdMatrix34_t renderPose;
+			float predictedSecondsToPhotons = 0.0f;
+			runtime.waitGetPoses(renderPose, predictedSecondsToPhotons);
+
+			auto cpuStart = std::chrono::high_resolution_clock::now();
+			timer.begin();
+			streamBuffer.beginFrame(glState);
+			frameAllocator.beginFrame();
+
+			glm::mat4 hmdModelMat = OpenVRWrapper::convertOpenVRMatrixToQMatrix(renderPose);
+			glm::mat4 view = glm::inverse(hmdModelMat);
+			glm::vec3 viewPosition(hmdModelMat[3]);
+			glm::mat4 eyeViewProjMat[2] = {
+				proj * glm::translate(glm::mat4(1.0f), glm::vec3(0.032f, 0.0f, 0.0f)) * view,
+				proj * glm::translate(glm::mat4(1.0f), glm::vec3(-0.032f, 0.0f, 0.0f)) * view
+			};
+			FrameVector<uint32_t> visible(frameAllocator.getArena());
+			scene.buildRenderQueue(jobSystem, renderQueue, visible, Frustum::combineStereo(eyeViewProjMat[0], eyeViewProjMat[1]), viewPosition);
+			renderQueue.upload(streamBuffer);
+			// the lights travel with the viewer, so every frame shades about as many of them
+			updateLights(lightCount, viewPosition, 4.0f, (float)runtime.getTime());
+			clusteredLighting.build(streamBuffer, view, eyeViewProjMat[0], eyeViewProjMat[1]);
+			streamBuffer.commit();
+			clusteredLighting.bind(glState, streamBuffer);
+
+			uint32_t drawCalls = 0;
+			uint32_t prepassDrawCalls = 0;
+			overdrawMonitor.setTargetSamples((uint64_t)target[0].getRenderWidth() * target[0].getRenderHeight() * target[0].getSamples());
+			for (int i = 0; i < 2; ++i)
+			{
+				glState.bindFramebuffer(GL_FRAMEBUFFER, target[i].getRenderFramebuffer());
+				clearScene(target[i].getRenderWidth(), target[i].getRenderHeight());
+				renderQueue.execute(glState, i, eyeViewProjMat[i], viewPosition, i == 0 ? &overdrawMonitor : nullptr);
+				drawCalls += renderQueue.getLastDrawCount();
+				prepassDrawCalls += renderQueue.getLastPrepassDrawCount();
+				target[i].resolve(glState);
+			}
+			streamBuffer.endFrame();
+			timer.end();
+			double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cpuStart).count();
+
+			// waiting for the GPU keeps every frame's query result with its own frame
+			glFinish();
+			double gpuMs = 0.0;
+			timer.getLastResult(gpuMs);
+			runtime.advance(cpuMs / 1000.0);
+			runtime.submit(gpuMs / 1000.0);
+			renderQueue.setAutoDepthPrepass(overdrawMonitor.update());
+
+			if (frame < warmupFrames)
+			{
+				continue;
+			}
+			uint32_t vsyncs = runtime.getLastVsyncCount();
+			fprintf(csv, "%u,%u,%u,%u,%d,%.3f,%.3f,%u,%u,%.3f,%u,%u,%u,%u\n", instanceCount, scene.getMeshCount(), scene.getMaterialCount(), lightCount,
+				frame - warmupFrames, cpuMs, gpuMs, drawCalls, prepassDrawCalls, overdrawMonitor.getOverdraw(), (uint32_t)visible.size(),
+				instanceCount - (uint32_t)visible.size(), clusteredLighting.getLastStats().entries, vsyncs);
+			cpuTimes.push_back(cpuMs);
+			gpuTimes.push_back(gpuMs);
+			totalDraws += drawCalls;
+			totalVisible += visible.size();
+			lateFrames += vsyncs > 1 ? 1 : 0;
+		}
+
+		std::sort(cpuTimes.begin(), cpuTimes.end());
+		std::sort(gpuTimes.begin(), gpuTimes.end());
+		size_t p99 = cpuTimes.size() * 99 / 100;
+		auto mean = [](const std::vector<double>& values)
+		{
+			double sum = 0.0;
+			for (double value : values)
+			{
+				sum += value;
+			}
+			return values.empty() ? 0.0 : sum / values.size();
+		};
+		if (frames > 0)
+		{
+			printf("%u, %.0f, %.2f (%.2f), %.2f (%.2f), %.0f, %.0f, %u of %d\n", instanceCount, buildMs, mean(cpuTimes), cpuTimes[p99],
+				mean(gpuTimes), gpuTimes[p99], totalDraws / frames, totalVisible / frames, lateFrames, frames);
+		}
+		scene.destroy();
+	}
+
+	timer.destroy();
+	for (int i = 0; i < 2; ++i)
+	{
+		target[i].destroy();
+	}
+	fclose(csv);
+	printf("Per-frame results written to %s\n", csvPath);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--job-benchmark") == 0)
+	{
+		runJobScalingBenchmark();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--latency-simulation") == 0)
+	{
+		runLatencySimulation();
+		return 0;
+	}
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -99,6 +671,13 @@ int main()
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+	// the stress benchmark only renders offscreen, the window just provides the context
+	bool stressBenchmark = argc > 1 && strcmp(argv[1], "--stress-benchmark") == 0;
+	if (stressBenchmark)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
 	// glfw window creation
 	// --------------------
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "OpenVR OGL Demo", NULL, NULL);
@@ -130,7 +709,14 @@ int main()
 
 	// build and compile our shader zprogram
 	// ------------------------------------
-	shader.init("asset/shader/simple_vs.glsl", "asset/shader/simple_fs.glsl");
+	simpleShaderVariants.init("asset/shader/simple_vs.glsl", "asset/shader/simple_fs.glsl");
+	Shader& shader = simpleShaderVariants.get(shaderFeatures);
+	// the pre-pass has no lighting, none of the features apply to it
+	depthShaderVariants.init("asset/shader/depth_vs.glsl", "asset/shader/depth_fs.glsl");
+	renderQueue.setDepthPrepassProgram(depthShaderVariants.get(ShaderFeature_None).ID);
+	overdrawMonitor.init(DEPTH_PREPASS_OVERDRAW);
+	clusteredLighting.init();
+	updateLights(POINT_LIGHT_COUNT, LIGHT_CENTER, LIGHT_SPREAD, 0.0f);
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
@@ -227,29 +813,54 @@ int main()
 	shader.use();
 	shader.setInt("texture", 0);
 
+	buildScene();
+	jobSystem.init();
+	streamBuffer.init(STREAM_BUFFER_FRAME_SIZE);
+	frameAllocator.init(FRAME_ARENA_SIZE);
+
+	if (stressBenchmark || (argc > 1 && strcmp(argv[1], "--msaa-benchmark") == 0))
+	{
+		if (stressBenchmark)
+		{
+			runStressBenchmark(argc, argv);
+		}
+		else
+		{
+			runMsaaBenchmark();
+		}
+		clusteredLighting.destroy();
+		streamBuffer.destroy();
+		frameAllocator.destroy();
+		jobSystem.destroy();
+		glfwTerminate();
+		return 0;
+	}
+
 	openVRWrapper.init();
+	openVRWrapper.getFramePacer().setEnabled(FRAME_PACING);
+	openVRWrapper.setLatencyMeasurement(LATENCY_MEASUREMENT);
+	frameGpuTimer.init();
+	handRenderer.init(shaderFeatures);
+	renderModelRenderer.init(shaderFeatures);
 
 	// 
-	GLuint eyeFramebuffer[2];
-	GLuint eyeColorTexture[2];
-	GLuint eyeDepthTexture[2];
-	glGenFramebuffers(2, eyeFramebuffer);
-	glGenTextures(2, eyeColorTexture);
-	glGenRenderbuffers(2, eyeDepthTexture);
 	for (int i = 0; i < 2; ++i)
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, eyeFramebuffer[i]);
+		if (FOVEATED_RENDERING)
+		{
+			foveatedEyeTarget[i].init(VR_WIDTH, VR_HEIGHT, MSAA_SAMPLES, openVRWrapper.computeFoveationLayout(i, FOVEATION_THRESHOLD), EYE_SWAPCHAIN_LENGTH);
+		}
+		else
+		{
+			eyeRenderTarget[i].init(VR_WIDTH, VR_HEIGHT, MSAA_SAMPLES, 1.0f, EYE_SWAPCHAIN_LENGTH);
+		}
+	}
 
-		glBindTexture(GL_TEXTURE_2D, eyeColorTexture[i]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, VR_WIDTH, VR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, eyeColorTexture[i], 0);
+	mirrorWindow.init(window, MIRROR_MODE, MIRROR_RATE);
+	spectatorTarget.init((uint32_t)(SCR_WIDTH * SPECTATOR_SCALE), (uint32_t)(SCR_HEIGHT * SPECTATOR_SCALE));
 
-		glBindRenderbuffer(GL_RENDERBUFFER, eyeDepthTexture[i]);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, VR_WIDTH, VR_HEIGHT);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, eyeDepthTexture[i]);
-	}
+	// everything above bound state behind the cache's back
+	glState.invalidate();
 
 	// render loop
 	// -----------
@@ -260,36 +871,172 @@ int main()
 		float currentFrame = (float)glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
+		glState.beginFrame();
+		streamBuffer.beginFrame(glState);
+
+		if (currentFrame - lastStatsTime >= STATS_INTERVAL)
+		{
+			lastStatsTime = currentFrame;
+			const GLStateStats& stats = glState.getLastFrameStats();
+			printf("GL state calls per frame: %u issued, %u elided\n", stats.issued, stats.elided);
+			printf("Objects visible: %u of %u\n", (uint32_t)visibleObjects.size(), (uint32_t)renderables.size());
+			printf("Overdraw: %.2f, depth pre-pass %s for %u draws\n", overdrawMonitor.getOverdraw(),
+				overdrawMonitor.isAboveThreshold() ? "on" : "off", renderQueue.getLastPrepassDrawCount());
+			const ClusteredLightingStats& lighting = clusteredLighting.getLastStats();
+			printf("Point lights: %u of %u visible in %u cluster entries, at most %u per cluster, %u dropped\n", lighting.visibleLights, lighting.lights,
+				lighting.entries, lighting.maxClusterLights, lighting.dropped);
+			printf("Transforms updated: %u of %u\n", transformSystem.getLastUpdateCount(), transformSystem.getCount());
+			printf("Tracked device model components: %u in %u instanced draws\n", renderModelRenderer.getLastComponentCount(), renderModelRenderer.getLastDrawCount());
+			for (int i = 0; i < 2; ++i)
+			{
+				uint32_t stalls = FOVEATED_RENDERING ? foveatedEyeTarget[i].getStallCount() : eyeRenderTarget[i].getStallCount();
+				printf("Eye %d swapchain stalls: %u\n", i, stalls);
+			}
+			printf("Stream buffer: %zu of %zu KB used, %u stalls\n", streamBuffer.getLastFrameUsage() / 1024, streamBuffer.getFrameSize() / 1024, streamBuffer.getStallCount());
+			// still the previous frame's arena
+			const LinearArena& arena = frameAllocator.getArena();
+			printf("Frame arena: %zu of %zu KB in %u allocations, %u overflowed\n", arena.getUsed() / 1024, arena.getCapacity() / 1024,
+				arena.getAllocationCount(), arena.getOverflowCount());
+			HapticsStats haptics = openVRWrapper.getHaptics().takeStats();
+			printf("Haptic pulses: %u submitted, %u coalesced, %u dropped, %u expired, %u runtime calls\n",
+				haptics.submitted, haptics.coalesced, haptics.dropped, haptics.expired, haptics.issued);
+			FramePacerStats pacing = openVRWrapper.getFramePacer().takeStats();
+			printf("Frame pacing: %u of %u frames late, %.2f ms delayed per frame, min slack %.2f ms, CPU %.2f ms, GPU %.2f ms, margin %.2f ms\n",
+				pacing.violations, pacing.frames, pacing.frames ? pacing.delayed * 1000.0 / pacing.frames : 0.0, pacing.minSlack * 1000.0,
+				pacing.cpuEstimate * 1000.0, pacing.gpuEstimate * 1000.0, pacing.margin * 1000.0);
+			if (LATENCY_MEASUREMENT)
+			{
+				openVRWrapper.getLatencyHarness().print(false);
+				openVRWrapper.resetLatencyHarness();
+			}
+			if (HeapAllocationCheck::isEnabled())
+			{
+				printf("Frames with heap allocations after warmup: %u\n", heapCheck.getFailedFrameCount());
+			}
+		}
+		frameAllocator.beginFrame();
+		heapCheck.beginFrame();
 
 		// input
 		// -----
 		processInput(window);
 		openVRWrapper.update();
+		if (openVRWrapper.isQuitRequested())
+		{
+			glfwSetWindowShouldClose(window, true);
+		}
+		updateSceneTransforms();
 
+		buildRenderQueue(openVRWrapper.getViewProjMat(0), openVRWrapper.getViewProjMat(1), openVRWrapper.getHmdPosition());
+		updateLights(POINT_LIGHT_COUNT, LIGHT_CENTER, LIGHT_SPREAD, currentFrame);
+		clusteredLighting.build(streamBuffer, glm::inverse(openVRWrapper.getHmdModelMat()), openVRWrapper.getViewProjMat(0), openVRWrapper.getViewProjMat(1));
+		handRenderer.upload(streamBuffer, openVRWrapper.getHandSkeleton(), openVRWrapper.getInput());
+		queueTrackedDeviceModels();
+		renderModelRenderer.upload(glState, streamBuffer);
+		streamBuffer.commit();
+		clusteredLighting.bind(glState, streamBuffer);
+		GLuint eyeTexture[2];
+		frameGpuTimer.begin();
 		for (int i = 0; i < 2; ++i)
 		{
-			glBindFramebuffer(GL_FRAMEBUFFER, eyeFramebuffer[i]);
-			renderScene(openVRWrapper.getViewProjMat(i));
+			if (FOVEATED_RENDERING)
+			{
+				foveatedEyeTarget[i].acquire();
+				renderFoveatedEye(i, openVRWrapper.getViewProjMat(i), foveatedEyeTarget[i], i == 0 ? &overdrawMonitor : nullptr);
+				eyeTexture[i] = foveatedEyeTarget[i].getResolveTexture();
+				continue;
+			}
+
+			EyeRenderTarget& target = eyeRenderTarget[i];
+			target.acquire();
+			glState.bindFramebuffer(GL_FRAMEBUFFER, target.getRenderFramebuffer());
+			overdrawMonitor.setTargetSamples((uint64_t)target.getRenderWidth() * target.getRenderHeight() * target.getSamples());
+			renderScene(i, openVRWrapper.getViewProjMat(i), target.getRenderWidth(), target.getRenderHeight(), i == 0 ? &overdrawMonitor : nullptr);
+			target.resolve(glState);
+			eyeTexture[i] = target.getResolveTexture();
 		}
 
-		openVRWrapper.submit(eyeColorTexture[0], eyeColorTexture[1]);
+		frameGpuTimer.end();
+		openVRWrapper.submit(eyeTexture[0], eyeTexture[1]);
+		// fenced right after submit, which reads them; the mirror below reads them on this
+		// context and is ordered before any later frame's writes anyway
+		for (int i = 0; i < 2; ++i)
+		{
+			if (FOVEATED_RENDERING)
+			{
+				foveatedEyeTarget[i].release();
+			}
+			else
+			{
+				eyeRenderTarget[i].release();
+			}
+		}
+		double gpuMs = 0.0;
+		if (frameGpuTimer.getLastResult(gpuMs))
+		{
+			openVRWrapper.getFramePacer().addGpuTime(gpuMs / 1000.0);
+		}
+		renderQueue.setAutoDepthPrepass(overdrawMonitor.update());
+		// the compositor may touch GL state while consuming the textures
+		glState.invalidate();
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
+		// the mirror is optional work, skipped while the user is in the dashboard
+		if (!openVRWrapper.shouldReduceRenderingWork() && mirrorWindow.isDue(glfwGetTime()))
+		{
+			if (mirrorWindow.getMode() == MirrorMode_Spectator)
+			{
+				renderSpectator();
+			}
+			mirrorWindow.present(glState, openVRWrapper, eyeTexture[0], eyeTexture[1], spectatorTarget.getResolveTexture());
+		}
 		glfwPollEvents();
+
+		streamBuffer.endFrame();
+
+		// once warmed up, any heap allocation left in the frame is a bug
+		heapCheck.endFrame();
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
+	simpleShaderVariants.destroy();
+	depthShaderVariants.destroy();
+	overdrawMonitor.destroy();
+	clusteredLighting.destroy();
+	handRenderer.destroy();
+	renderModelRenderer.destroy();
+	frameGpuTimer.destroy();
+	mirrorWindow.destroy();
+	spectatorTarget.destroy();
+	streamBuffer.destroy();
+	frameAllocator.destroy();
+	for (int i = 0; i < 2; ++i)
+	{
+		if (FOVEATED_RENDERING)
+		{
+			foveatedEyeTarget[i].destroy();
+		}
+		else
+		{
+			eyeRenderTarget[i].destroy();
+		}
+	}
 
+	jobSystem.destroy();
 	openVRWrapper.destroy();
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
+	if (heapCheck.hasFailed())
+	{
+		printf("Failed: %u frames made heap allocations after warmup\n", heapCheck.getFailedFrameCount());
+		return 1;
+	}
 	return 0;
 }
 
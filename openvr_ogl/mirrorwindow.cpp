@@ -0,0 +1,103 @@
+#include "mirrorwindow.h"
+#include "glstatecache.h"
+#include "openvrwrapper.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+
+void MirrorWindow::init(GLFWwindow* window, EMirrorMode mode, float rate)
+{
+	this->window = window;
+	this->mode = mode;
+	interval = rate > 0.0f ? 1.0 / rate : 0.0;
+	nextPresentTime = 0.0;
+
+	// the HMD frame is paced by the compositor, the desktop swap must never block on vsync
+	glfwSwapInterval(0);
+
+	glGenFramebuffers(1, &readFramebuffer);
+}
+
+void MirrorWindow::destroy()
+{
+	glDeleteFramebuffers(1, &readFramebuffer);
+	readFramebuffer = 0;
+}
+
+bool MirrorWindow::isDue(double time)
+{
+	if (mode == MirrorMode_None || time < nextPresentTime)
+	{
+		return false;
+	}
+	// skip missed slots rather than catching up with a burst of presents
+	nextPresentTime = std::max(nextPresentTime + interval, time);
+	return true;
+}
+
+void MirrorWindow::present(GLStateCache& glState, OpenVRWrapper& openVRWrapper, GLuint leftEyeTexture, GLuint rightEyeTexture, GLuint spectatorTexture)
+{
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+
+	glState.bindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glState.setEnabled(GL_SCISSOR_TEST, false);
+	glState.colorMask(true);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	if (mode == MirrorMode_LeftEye)
+	{
+		blitEye(glState, leftEyeTexture, 0, 0, width, height);
+	}
+	else if (mode == MirrorMode_BothEyes)
+	{
+		blitEye(glState, leftEyeTexture, 0, 0, width / 2, height);
+		blitEye(glState, rightEyeTexture, width / 2, 0, width - width / 2, height);
+	}
+	else if (mode == MirrorMode_Compositor)
+	{
+		for (uint32_t eye = 0; eye < 2; ++eye)
+		{
+			uint32_t texture = 0;
+			if (openVRWrapper.lockMirrorTexture(eye, texture))
+			{
+				blitEye(glState, texture, eye * (width / 2), 0, eye ? width - width / 2 : width / 2, height);
+				openVRWrapper.unlockMirrorTexture(eye);
+			}
+		}
+	}
+	else if (mode == MirrorMode_Spectator && spectatorTexture)
+	{
+		blitEye(glState, spectatorTexture, 0, 0, width, height);
+	}
+
+	glfwSwapBuffers(window);
+}
+
+void MirrorWindow::blitEye(GLStateCache& glState, GLuint texture, int x, int y, int width, int height)
+{
+	glState.bindTexture(0, GL_TEXTURE_2D, texture);
+	GLint textureWidth = 0, textureHeight = 0;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &textureWidth);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &textureHeight);
+	if (textureWidth == 0 || textureHeight == 0)
+	{
+		return;
+	}
+
+	glState.bindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+	// fit the eye into its part of the window without stretching it
+	float scale = std::min((float)width / textureWidth, (float)height / textureHeight);
+	int fitWidth = (int)(textureWidth * scale);
+	int fitHeight = (int)(textureHeight * scale);
+	int fitX = x + (width - fitWidth) / 2;
+	int fitY = y + (height - fitHeight) / 2;
+	glBlitFramebuffer(0, 0, textureWidth, textureHeight, fitX, fitY, fitX + fitWidth, fitY + fitHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+}
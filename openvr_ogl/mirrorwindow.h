@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+struct GLFWwindow;
+class GLStateCache;
+class OpenVRWrapper;
+
+enum EMirrorMode
+{
+	MirrorMode_None,
+	// the left eye texture scaled to fit the window
+	MirrorMode_LeftEye,
+	// both eye textures side by side
+	MirrorMode_BothEyes,
+	// both eyes as the compositor distorted them, from IVRCompositor::GetMirrorTextureGL
+	MirrorMode_Compositor,
+	// a third person view from the desktop camera, rendered by the application into its own texture
+	MirrorMode_Spectator,
+	MirrorMode_Count
+};
+
+// Shows what the HMD sees in the desktop window by blitting the already rendered eye textures
+// downscaled into the default framebuffer, so the scene is never rendered again for it. The
+// window is presented at its own lower rate with vsync off, so swapping it never waits on the
+// desktop refresh and cannot hold up the next HMD frame.
+class MirrorWindow
+{
+public:
+	void init(GLFWwindow* window, EMirrorMode mode, float rate);
+	void destroy();
+
+	// Whether the mirror is due at time (in seconds); a true result schedules the next present,
+	// so anything only the mirror needs, like the spectator view, is rendered at the mirror's rate
+	bool isDue(double time);
+	// Blits the textures for the current mode into the window and swaps it
+	void present(GLStateCache& glState, OpenVRWrapper& openVRWrapper, GLuint leftEyeTexture, GLuint rightEyeTexture, GLuint spectatorTexture = 0);
+
+	void setMode(EMirrorMode mode) { this->mode = mode; }
+	EMirrorMode getMode() const { return mode; }
+
+private:
+	void blitEye(GLStateCache& glState, GLuint texture, int x, int y, int width, int height);
+
+	GLFWwindow* window = nullptr;
+	EMirrorMode mode = MirrorMode_None;
+	double interval = 0.0;
+	double nextPresentTime = 0.0;
+
+	// eye textures are attached to this one by one to read from them
+	GLuint readFramebuffer = 0;
+};
@@ -1,9 +1,13 @@
 #include "openvrwrapper.h"
-#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 void OpenVRWrapper::init()
 {
 	memset(deviceClassChar, 0, sizeof(deviceClassChar));
+	memset(deviceRenderModel, 0, sizeof(deviceRenderModel));
 
 	if (!vr::VR_IsHmdPresent())
 	{
@@ -35,43 +39,76 @@ void OpenVRWrapper::init()
 	printf("Initialized HMD with driver: %s, display: %s, suggested render target size: %d*%d\n", 
 		driverName.c_str(), displayName.c_str(), rtWidth, rtHeight);
 
-	eyeViewProjMat[0] = getEyeProjMat(vr::Eye_Left) * getEyeViewMat(vr::Eye_Left);
-	eyeViewProjMat[1] = getEyeProjMat(vr::Eye_Right) * getEyeViewMat(vr::Eye_Right);
+	float displayFrequency = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+	frameInterval = displayFrequency > 0.0f ? 1.0f / displayFrequency : 1.0f / 90.0f;
+	vsyncToPhotons = system->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
 
-	vr::EVRInputError inputError = vr::VRInputError_None;
-	inputError = vr::VRInput()->SetActionManifestPath("E:/VRViewer/openvr_ogl/openvr_ogl/asset/config/actions.json");
-	if (inputError != vr::VRInputError_None)
+	latencySource.init(system);
+
+	// devices connected before the application started send no activation event
+	for (vr::TrackedDeviceIndex_t device = 0; device < vr::k_unMaxTrackedDeviceCount; ++device)
 	{
-		printf("Failed to SetActionManifestPath, error: %d", inputError);
+		refreshDeviceRenderModel(device);
 	}
 
-	inputError = vr::VRInput()->GetActionSetHandle("/actions/main", &actionSet);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/trigger", &triggerAction);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/grip", &gripAction);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/trackpad", &trackpadAction);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/application_menu", &menuAction);
+	eyeViewProjMat[0] = getEyeProjMat(vr::Eye_Left) * getEyeViewMat(vr::Eye_Left);
+	eyeViewProjMat[1] = getEyeProjMat(vr::Eye_Right) * getEyeViewMat(vr::Eye_Right);
 
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/out/haptic_left", &controller[0].hapticAction);
-	inputError = vr::VRInput()->GetInputSourceHandle("/user/hand/left", &controller[0].source);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/hand_left", &controller[0].poseAction);
+	input.init("asset/config/actions.json");
+	haptics.init(input.getActionCount());
 
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/out/haptic_right", &controller[1].hapticAction);
-	inputError = vr::VRInput()->GetInputSourceHandle("/user/hand/right", &controller[1].source);
-	inputError = vr::VRInput()->GetActionHandle("/actions/main/in/hand_right", &controller[1].poseAction);
+	// one batch per frame; the range also holds user interaction events, the handler skips them
+	eventBus.subscribe<OpenVRWrapper, &OpenVRWrapper::onTrackedDeviceEvents>(vr::VREvent_TrackedDeviceActivated, vr::VREvent_TrackedDeviceRoleChanged, this);
+	eventBus.subscribe<OpenVRWrapper, &OpenVRWrapper::onFocusEvents>(vr::VREvent_InputFocusChanged, vr::VREvent_InputFocusChanged, this);
+	eventBus.subscribe<OpenVRWrapper, &OpenVRWrapper::onFocusEvents>(vr::VREvent_DashboardActivated, vr::VREvent_DashboardDeactivated, this);
+	eventBus.subscribe<OpenVRWrapper, &OpenVRWrapper::onQuitEvents>(vr::VREvent_Quit, vr::VREvent_Quit, this);
+	input.subscribeEvents(eventBus);
 }
 
 void OpenVRWrapper::update()
 {
-	updateInput();
-	updateTrackedDevicePose();
+	waitTrackedDevicePose();
+	double waitTime = latencySource.getTime();
+
+	// running start: with time to spare the frame starts later, and poses and input are sampled
+	// again for the shorter time left until they are displayed
+	float poseSecondsFromNow = -1.0f;
+	lateHmdPose = false;
+	if (framePacer.beginFrame(predictSecondsToDeadline()))
+	{
+		poseSecondsFromNow = predictSecondsToPhotons();
+		if (poseSecondsFromNow >= 0.0f)
+		{
+			refreshTrackedDevicePose(poseSecondsFromNow);
+			lateHmdPose = true;
+		}
+	}
+	updateTrackedDeviceMatrices();
+
+	if (measureLatency)
+	{
+		float predictedSecondsToPhotons = lateHmdPose ? poseSecondsFromNow : predictSecondsToPhotons();
+		if (predictedSecondsToPhotons >= 0.0f)
+		{
+			latencyHarness.beginFrame(latencySource, waitTime, predictedSecondsToPhotons,
+				trackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking);
+		}
+	}
+
+	updateInput(poseSecondsFromNow);
+	haptics.flush(input);
 }
 
 void OpenVRWrapper::destroy()
 {
 	for (int i = 0; i < 2; ++i)
 	{
-		vr::VRRenderModels()->FreeRenderModel(controller[i].model);
-		vr::VRRenderModels()->FreeTexture(controller[i].texture);
+		if (mirrorSharedHandle[i])
+		{
+			vr::VRCompositor()->ReleaseSharedGLTexture(mirrorTexture[i], mirrorSharedHandle[i]);
+			mirrorTexture[i] = 0;
+			mirrorSharedHandle[i] = nullptr;
+		}
 	}
 
 	if (system)
@@ -86,23 +123,140 @@ glm::mat4 OpenVRWrapper::getViewProjMat(uint32_t hand)
 	return eyeViewProjMat[hand] * hmdModelMat;
 }
 
+glm::vec3 OpenVRWrapper::getHmdPosition()
+{
+	return glm::vec3(trackedDeviceModelMat[vr::k_unTrackedDeviceIndex_Hmd][3]);
+}
+
 void OpenVRWrapper::submit(uint32_t leftEyeTextureID, uint32_t rightEyeTextureID)
 {
-	vr::Texture_t leftEyeTexture = { (void*)(uintptr_t)leftEyeTextureID, vr::TextureType_OpenGL, vr::ColorSpace_Gamma };
-	vr::Texture_t rightEyeTexture = { (void*)(uintptr_t)rightEyeTextureID, vr::TextureType_OpenGL, vr::ColorSpace_Gamma };
+	vr::VRTextureWithPose_t leftEyeTexture;
+	leftEyeTexture.handle = (void*)(uintptr_t)leftEyeTextureID;
+	leftEyeTexture.eType = vr::TextureType_OpenGL;
+	leftEyeTexture.eColorSpace = vr::ColorSpace_Gamma;
+	leftEyeTexture.mDeviceToAbsoluteTracking = trackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking;
+	vr::VRTextureWithPose_t rightEyeTexture = leftEyeTexture;
+	rightEyeTexture.handle = (void*)(uintptr_t)rightEyeTextureID;
+	// reprojection has to start from the late pose the frame was rendered with, not WaitGetPoses' one
+	vr::EVRSubmitFlags submitFlags = lateHmdPose ? vr::Submit_TextureWithPose : vr::Submit_Default;
 
 	vr::EVRCompositorError CompositorError;
-	CompositorError = vr::VRCompositor()->Submit(vr::Eye_Left, &leftEyeTexture);
+	CompositorError = vr::VRCompositor()->Submit(vr::Eye_Left, &leftEyeTexture, nullptr, submitFlags);
 	if (CompositorError != vr::VRCompositorError_None)
 	{
 		printf("Failed to submit left eye texture! Error: %d\n", CompositorError);
 	}
 
-	CompositorError = vr::VRCompositor()->Submit(vr::Eye_Right, &rightEyeTexture);
+	CompositorError = vr::VRCompositor()->Submit(vr::Eye_Right, &rightEyeTexture, nullptr, submitFlags);
 	if (CompositorError != vr::VRCompositorError_None)
 	{
 		printf("Failed to submit right eye texture! Error: %d\n", CompositorError);
 	}	
+	framePacer.endFrame();
+	if (measureLatency)
+	{
+		latencyHarness.endFrame(latencySource);
+	}
+}
+
+bool OpenVRWrapper::lockMirrorTexture(uint32_t eye, uint32_t& texture)
+{
+	if (!mirrorSharedHandle[eye])
+	{
+		vr::EVRCompositorError error = vr::VRCompositor()->GetMirrorTextureGL((vr::EVREye)eye, &mirrorTexture[eye], &mirrorSharedHandle[eye]);
+		if (error != vr::VRCompositorError_None)
+		{
+			printf("Failed to get mirror texture for eye %u! Error: %d\n", eye, error);
+			mirrorTexture[eye] = 0;
+			mirrorSharedHandle[eye] = nullptr;
+			return false;
+		}
+	}
+
+	vr::VRCompositor()->LockGLSharedTextureForAccess(mirrorSharedHandle[eye]);
+	texture = mirrorTexture[eye];
+	return true;
+}
+
+void OpenVRWrapper::unlockMirrorTexture(uint32_t eye)
+{
+	vr::VRCompositor()->UnlockGLSharedTextureForAccess(mirrorSharedHandle[eye]);
+}
+
+FoveationLayout OpenVRWrapper::computeFoveationLayout(uint32_t eye, float threshold, uint32_t gridSize)
+{
+	// render target uv sampled by the compositor at each display grid point
+	uint32_t stride = gridSize + 1;
+	std::vector<glm::vec2> uv(stride * stride);
+	for (uint32_t y = 0; y <= gridSize; ++y)
+	{
+		for (uint32_t x = 0; x <= gridSize; ++x)
+		{
+			vr::DistortionCoordinates_t coordinates;
+			if (!system->ComputeDistortion((vr::EVREye)eye, (float)x / gridSize, (float)y / gridSize, &coordinates))
+			{
+				printf("Failed to compute distortion for eye %u, using the default foveation layout\n", eye);
+				return FoveationLayout();
+			}
+			// OpenVR's v runs top down, GL textures bottom up
+			uv[y * stride + x] = glm::vec2(coordinates.rfGreen[0], 1.0f - coordinates.rfGreen[1]);
+		}
+	}
+
+	// relative density per display cell: display area over the render target area it samples
+	std::vector<float> density(gridSize * gridSize);
+	std::vector<glm::vec2> cellCenter(gridSize * gridSize);
+	float maxDensity = 0.0f;
+	for (uint32_t y = 0; y < gridSize; ++y)
+	{
+		for (uint32_t x = 0; x < gridSize; ++x)
+		{
+			const glm::vec2& origin = uv[y * stride + x];
+			glm::vec2 du = uv[y * stride + x + 1] - origin;
+			glm::vec2 dv = uv[(y + 1) * stride + x] - origin;
+			float area = std::abs(du.x * dv.y - du.y * dv.x);
+			uint32_t cell = y * gridSize + x;
+			density[cell] = area > 0.0f ? 1.0f / std::sqrt(area) : 0.0f;
+			cellCenter[cell] = (origin + uv[(y + 1) * stride + x + 1]) * 0.5f;
+			maxDensity = std::max(maxDensity, density[cell]);
+		}
+	}
+
+	FoveationLayout layout;
+	if (maxDensity <= 0.0f)
+	{
+		return layout;
+	}
+
+	layout.centerMin = glm::vec2(1.0f);
+	layout.centerMax = glm::vec2(0.0f);
+	for (size_t i = 0; i < density.size(); ++i)
+	{
+		if (density[i] >= threshold * maxDensity)
+		{
+			layout.centerMin = glm::min(layout.centerMin, cellCenter[i]);
+			layout.centerMax = glm::max(layout.centerMax, cellCenter[i]);
+		}
+	}
+	layout.centerMin = glm::clamp(layout.centerMin, glm::vec2(0.0f), glm::vec2(1.0f));
+	layout.centerMax = glm::clamp(layout.centerMax, layout.centerMin, glm::vec2(1.0f));
+
+	float peripheryDensity = 0.0f;
+	for (size_t i = 0; i < density.size(); ++i)
+	{
+		const glm::vec2& center = cellCenter[i];
+		bool inTarget = center.x >= 0.0f && center.y >= 0.0f && center.x <= 1.0f && center.y <= 1.0f;
+		bool inCenter = glm::all(glm::greaterThanEqual(center, layout.centerMin)) && glm::all(glm::lessThanEqual(center, layout.centerMax));
+		if (inTarget && !inCenter)
+		{
+			peripheryDensity = std::max(peripheryDensity, density[i] / maxDensity);
+		}
+	}
+	layout.peripheryScale = glm::clamp(peripheryDensity, 0.25f, 1.0f);
+
+	printf("Eye %u foveation: center (%.2f, %.2f)-(%.2f, %.2f), periphery scale %.2f\n", eye,
+		layout.centerMin.x, layout.centerMin.y, layout.centerMax.x, layout.centerMax.y, layout.peripheryScale);
+	return layout;
 }
 
 std::string OpenVRWrapper::getTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop, vr::TrackedPropertyError* peError /*= nullptr*/)
@@ -113,12 +267,13 @@ std::string OpenVRWrapper::getTrackedDeviceString(vr::TrackedDeviceIndex_t unDev
 		return "";
 	}
 
-	char *pchBuffer = new char[unRequiredBufferLen];
-	unRequiredBufferLen = vr::VRSystem()->GetStringTrackedDeviceProperty(unDevice, prop, pchBuffer, unRequiredBufferLen, peError);
-	std::string sResult = pchBuffer;
-	delete[] pchBuffer;
-
-	return sResult;
+	// read straight into the string, sized by the query above including the terminator; only
+	// called at startup, never every frame
+	std::string value(unRequiredBufferLen, '\0');
+	unRequiredBufferLen = vr::VRSystem()->GetStringTrackedDeviceProperty(unDevice, prop, &value[0], (uint32_t)value.size(), peError);
+	// a string that grew in between does not fit and is dropped
+	value.resize(unRequiredBufferLen > 0 && unRequiredBufferLen <= value.size() ? unRequiredBufferLen - 1 : 0);
+	return value;
 }
 
 glm::mat4 OpenVRWrapper::getEyeProjMat(vr::Hmd_Eye nEye, float fNear, float fFar)
@@ -156,74 +311,97 @@ glm::mat4 OpenVRWrapper::convertOpenVRMatrixToQMatrix(const vr::HmdMatrix34_t &m
 	);
 }
 
-void OpenVRWrapper::updateInput()
+void OpenVRWrapper::updateInput(float poseSecondsFromNow)
 {
-	vr::VREvent_t event;
-	while (system->PollNextEvent(&event, sizeof(event)))
-	{
-		handleVREvent(event);
-	}
+	eventBus.poll(system);
 
-	vr::VRActiveActionSet_t activeActionSet = { actionSet };
-	vr::VRInput()->UpdateActionState(&activeActionSet, sizeof(activeActionSet), 1);
+	input.update(poseSecondsFromNow);
+	handSkeleton.update(input);
+	bTrigger = input.isDown(Action_Trigger);
 
-	bTrigger = getDigitalActionState(triggerAction, EDigitalActionStateType::All);
-
-	vr::VRInputValueHandle_t ulHapticDevice;
-	if (getDigitalActionState(gripAction, EDigitalActionStateType::Rising, &ulHapticDevice))
+	if (input.wasPressed(Action_Grip) && input.getSource(Action_Grip) != InputSource_Count)
 	{
-		if (ulHapticDevice == controller[0].source)
-		{
-			vr::VRInput()->TriggerHapticVibrationAction(controller[0].hapticAction, 0.0f, 1.0f, 4.0f, 1.0f, vr::k_ulInvalidInputValueHandle);
-		}
-		if (ulHapticDevice == controller[1].source)
-		{
-			vr::VRInput()->TriggerHapticVibrationAction(controller[1].hapticAction, 0.0f, 1.0f, 4.0f, 1.0f, vr::k_ulInvalidInputValueHandle);
-		}
+		EAction haptic = input.getSource(Action_Grip) == InputSource_LeftHand ? Action_HapticLeft : Action_HapticRight;
+		haptics.submit(haptic, 0.0f, 1.0f, 4.0f, 1.0f);
 	}
 
-	vr::InputAnalogActionData_t analogData;
-	if (vr::VRInput()->GetAnalogActionData(trackpadAction, &analogData, sizeof(analogData), 
-		vr::k_ulInvalidInputValueHandle) == vr::VRInputError_None && analogData.bActive)
+	if (input.isActive(Action_Trackpad))
 	{
-		trackpad[0] = analogData.x;
-		trackpad[1] = analogData.y;
+		trackpad = glm::vec2(input.getAxis(Action_Trackpad));
 	}
 
 	for (int i = 0; i < 2; ++i)
 	{
 		Controller& hand = controller[i];
-		vr::InputPoseActionData_t poseData;
-		if (vr::VRInput()->GetPoseActionDataForNextFrame(hand.poseAction, vr::TrackingUniverseStanding, &poseData, 
-			sizeof(poseData), vr::k_ulInvalidInputValueHandle) == vr::VRInputError_None && poseData.bActive && poseData.pose.bPoseIsValid)
+		EAction poseAction = i == 0 ? Action_HandLeft : Action_HandRight;
+		if (input.isPoseValid(poseAction))
 		{
-			hand.modelMat = convertOpenVRMatrixToQMatrix(poseData.pose.mDeviceToAbsoluteTracking);
+			hand.modelMat = input.getPose(poseAction);
 
-			vr::InputOriginInfo_t originInfo;
-			if (vr::VRInput()->GetOriginTrackedDeviceInfo(poseData.activeOrigin, &originInfo, sizeof(originInfo)) == vr::VRInputError_None
-				&& originInfo.trackedDeviceIndex != vr::k_unTrackedDeviceIndexInvalid)
+			vr::TrackedDeviceIndex_t device = input.getPoseDevice(poseAction);
+			if (device != vr::k_unTrackedDeviceIndexInvalid)
 			{
-				std::string renderModelName = getTrackedDeviceString(originInfo.trackedDeviceIndex, vr::Prop_RenderModelName_String);
-				if (!hand.model)
-				{
-					loadRenderModel(renderModelName.c_str(), hand.model, hand.texture);
-				}
+				hand.device = device;
 			}
 		}
 	}
 }
 
-void OpenVRWrapper::updateTrackedDevicePose()
+void OpenVRWrapper::waitTrackedDevicePose()
 {
 	vr::VRCompositor()->WaitGetPoses(trackedDevicePose, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
 
-	int validPoseCount = 0;
-	std::string poseClasses = "";
+	// WaitGetPoses returns shortly before a vsync and predicts for the one after it
+	float secondsSinceVsync = 0.0f;
+	uint64_t vsyncCounter = 0;
+	targetVsync = system->GetTimeSinceLastVsync(&secondsSinceVsync, &vsyncCounter) ? vsyncCounter + 2 : 0;
+}
+
+float OpenVRWrapper::secondsToTargetVsync()
+{
+	float secondsSinceVsync = 0.0f;
+	uint64_t vsyncCounter = 0;
+	if (targetVsync == 0 || !system->GetTimeSinceLastVsync(&secondsSinceVsync, &vsyncCounter) || vsyncCounter >= targetVsync)
+	{
+		return -1.0f;
+	}
+	return (targetVsync - vsyncCounter) * frameInterval - secondsSinceVsync;
+}
+
+float OpenVRWrapper::predictSecondsToPhotons()
+{
+	float secondsToVsync = secondsToTargetVsync();
+	return secondsToVsync >= 0.0f ? secondsToVsync + vsyncToPhotons : -1.0f;
+}
+
+double OpenVRWrapper::predictSecondsToDeadline()
+{
+	float secondsToVsync = secondsToTargetVsync();
+	if (secondsToVsync < 0.0f)
+	{
+		// without vsync timing there is no pose prediction either, so nothing to keep consistent
+		return vr::VRCompositor()->GetFrameTimeRemaining();
+	}
+
+	// the compositor has to finish its own pass on the frame before the target vsync; the last
+	// frame's pass is the estimate
+	vr::Compositor_FrameTiming timing = {};
+	timing.m_nSize = sizeof(timing);
+	float compositorSeconds = vr::VRCompositor()->GetFrameTiming(&timing, 0) ? timing.m_flCompositorRenderGpuMs * 0.001f : 0.0f;
+	return secondsToVsync - compositorSeconds;
+}
+
+void OpenVRWrapper::refreshTrackedDevicePose(float secondsToPhotons)
+{
+	system->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseStanding, secondsToPhotons, trackedDevicePose, vr::k_unMaxTrackedDeviceCount);
+}
+
+void OpenVRWrapper::updateTrackedDeviceMatrices()
+{
 	for (int nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; ++nDevice)
 	{
 		if (trackedDevicePose[nDevice].bPoseIsValid)
 		{
-			validPoseCount++;
 			trackedDeviceModelMat[nDevice] = convertOpenVRMatrixToQMatrix(trackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
 			if (deviceClassChar[nDevice] == 0)
 			{
@@ -237,7 +415,6 @@ void OpenVRWrapper::updateTrackedDevicePose()
 				default:                                       deviceClassChar[nDevice] = '?'; break;
 				}
 			}
-			poseClasses += deviceClassChar[nDevice];
 		}
 	}
 
@@ -247,92 +424,90 @@ void OpenVRWrapper::updateTrackedDevicePose()
 	}
 }
 
-void OpenVRWrapper::handleVREvent(const vr::VREvent_t& event)
+vr::VRInputValueHandle_t OpenVRWrapper::getDeviceInputPath(vr::TrackedDeviceIndex_t device) const
 {
-	switch (event.eventType)
-	{
-	case vr::VREvent_TrackedDeviceDeactivated:
+	for (uint32_t i = 0; i < InputSource_Count; ++i)
 	{
-		printf("Device %d detached\n", event.trackedDeviceIndex);
-	}
-	break;
-	case vr::VREvent_TrackedDeviceUpdated:
-	{
-		printf("Device %d updated\n", event.trackedDeviceIndex);
-	}
-	break;
+		if (controller[i].device == device)
+		{
+			return input.getSourceHandle((EInputSource)i);
+		}
 	}
+	return vr::k_ulInvalidInputValueHandle;
 }
 
-bool OpenVRWrapper::getDigitalActionState(vr::VRActionHandle_t action, EDigitalActionStateType digitalActionStateType, vr::VRInputValueHandle_t *pDevicePath /*= nullptr*/)
+void OpenVRWrapper::onTrackedDeviceEvents(const vr::VREvent_t* events, uint32_t count)
 {
-	vr::InputDigitalActionData_t actionData;
-	vr::VRInput()->GetDigitalActionData(action, &actionData, sizeof(actionData), vr::k_ulInvalidInputValueHandle);
-	if (pDevicePath)
+	for (uint32_t i = 0; i < count; ++i)
 	{
-		*pDevicePath = vr::k_ulInvalidInputValueHandle;
-		if (actionData.bActive)
+		const vr::VREvent_t& event = events[i];
+		vr::TrackedDeviceIndex_t device = event.trackedDeviceIndex;
+		if (device >= vr::k_unMaxTrackedDeviceCount)
+		{
+			continue;
+		}
+
+		switch (event.eventType)
 		{
-			vr::InputOriginInfo_t originInfo;
-			if (vr::VRInputError_None == vr::VRInput()->GetOriginTrackedDeviceInfo(actionData.activeOrigin, &originInfo, sizeof(originInfo)))
+		case vr::VREvent_TrackedDeviceDeactivated:
+		{
+			printf("Device %d detached\n", device);
+			deviceRenderModel[device][0] = 0;
+			for (Controller& hand : controller)
 			{
-				*pDevicePath = originInfo.devicePath;
+				if (hand.device == device)
+				{
+					hand.device = vr::k_unTrackedDeviceIndexInvalid;
+				}
 			}
 		}
-	}
-
-	switch (digitalActionStateType)
-	{
-	case EDigitalActionStateType::Rising:
-		return actionData.bActive && actionData.bChanged && actionData.bState;
-	case EDigitalActionStateType::Falling:
-		return actionData.bActive && actionData.bChanged && !actionData.bState;
-	case EDigitalActionStateType::All:
-		return actionData.bActive && actionData.bState;
-	default:
-		return false;
-	}
-}
-
-void OpenVRWrapper::loadRenderModel(const char* name, vr::RenderModel_t*& model, vr::RenderModel_TextureMap_t*& texture)
-{
-	vr::EVRRenderModelError error;
-	int aysncLoadSleepTime = 1;
-	while (true)
-	{
-		error = vr::VRRenderModels()->LoadRenderModel_Async(name, &model);
-		if (error != vr::VRRenderModelError_Loading)
+		break;
+		case vr::VREvent_TrackedDeviceUpdated:
 		{
+			printf("Device %d updated\n", device);
+			refreshDeviceRenderModel(device);
+		}
+		break;
+		case vr::VREvent_TrackedDeviceActivated:
+			refreshDeviceRenderModel(device);
 			break;
+		case vr::VREvent_TrackedDeviceRoleChanged:
+			break;
+		default:
+			continue;
 		}
 
-		std::this_thread::sleep_for(std::chrono::seconds(aysncLoadSleepTime));
-	}
-
-	if (error != vr::VRRenderModelError_None || !model)
-	{
-		printf("Failed to load render model %s, error: %s\n", name,
-			vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
-
-		return;
+		// the device class is cached per index and looked up again after any of these
+		deviceClassChar[device] = 0;
 	}
+}
 
-	while (true)
+void OpenVRWrapper::refreshDeviceRenderModel(vr::TrackedDeviceIndex_t device)
+{
+	vr::TrackedPropertyError error = vr::TrackedProp_Success;
+	system->GetStringTrackedDeviceProperty(device, vr::Prop_RenderModelName_String, deviceRenderModel[device], MAX_RENDER_MODEL_NAME, &error);
+	if (error != vr::TrackedProp_Success)
 	{
-		error = vr::VRRenderModels()->LoadTexture_Async(model->diffuseTextureId, &texture);
-		if (error != vr::VRRenderModelError_Loading)
+		if (error == vr::TrackedProp_BufferTooSmall)
 		{
-			break;
+			printf("Render model name of device %u is too long, it is not drawn\n", device);
 		}
-
-		std::this_thread::sleep_for(std::chrono::seconds(aysncLoadSleepTime));
+		deviceRenderModel[device][0] = 0;
 	}
+}
 
-	if (error != vr::VRRenderModelError_None || !texture)
-	{
-		printf("Failed to load render model %s's texture id %d\n", name, model->diffuseTextureId);
-		vr::VRRenderModels()->FreeRenderModel(model);
+void OpenVRWrapper::onFocusEvents()
+{
+	// the events only tell that something changed, one query covers the whole batch
+	reduceRenderingWork = system->ShouldApplicationReduceRenderingWork();
+}
 
-		return;
+void OpenVRWrapper::onQuitEvents()
+{
+	if (!quitRequested)
+	{
+		printf("Runtime requested quit\n");
+		system->AcknowledgeQuit_Exiting();
+		quitRequested = true;
 	}
 }
@@ -1,22 +1,31 @@
 #pragma once
 
+#include "inputsystem.h"
+#include "handskeleton.h"
+#include "hapticsscheduler.h"
+#include "vreventbus.h"
+#include "framepacer.h"
+#include "latencyharness.h"
+
 #include <openvr.h>
 #include <glm/glm.hpp>
 
-enum class EDigitalActionStateType
-{
-	Rising, Falling, All
-};
+#include <string>
 
 struct Controller
 {
-	vr::VRInputValueHandle_t source = vr::k_ulInvalidInputValueHandle;
-	vr::VRActionHandle_t poseAction = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t hapticAction = vr::k_ulInvalidActionHandle;
+	glm::mat4 modelMat = glm::mat4(1.0f);
+	// device driving the hand, its render model components animate with this hand's input
+	vr::TrackedDeviceIndex_t device = vr::k_unTrackedDeviceIndexInvalid;
+};
 
-	glm::mat4 modelMat;
-	vr::RenderModel_t* model = nullptr;
-	vr::RenderModel_TextureMap_t* texture = nullptr;
+// Split of one eye's render target into a full resolution center and a reduced resolution
+// periphery, in render target uv (origin bottom left)
+struct FoveationLayout
+{
+	glm::vec2 centerMin = glm::vec2(0.25f);
+	glm::vec2 centerMax = glm::vec2(0.75f);
+	float peripheryScale = 0.5f;
 };
 
 class OpenVRWrapper
@@ -27,20 +36,68 @@ public:
 	void destroy();
 
 	glm::mat4 getViewProjMat(uint32_t hand);
+	glm::vec3 getHmdPosition();
+	const glm::mat4& getHmdModelMat() { return trackedDeviceModelMat[vr::k_unTrackedDeviceIndex_Hmd]; }
+	const glm::mat4& getControllerModelMat(uint32_t hand) { return controller[hand].modelMat; }
+	// every tracked device as of the last update, the render model name is empty for devices without one
+	bool isDevicePoseValid(vr::TrackedDeviceIndex_t device) const { return trackedDevicePose[device].bPoseIsValid; }
+	const glm::mat4& getDeviceModelMat(vr::TrackedDeviceIndex_t device) const { return trackedDeviceModelMat[device]; }
+	const char* getDeviceRenderModel(vr::TrackedDeviceIndex_t device) const { return deviceRenderModel[device]; }
+	// input source path of a controller driving a hand, vr::k_ulInvalidInputValueHandle for other devices
+	vr::VRInputValueHandle_t getDeviceInputPath(vr::TrackedDeviceIndex_t device) const;
+	const InputSystem& getInput() const { return input; }
+	const HandSkeleton& getHandSkeleton() const { return handSkeleton; }
+	// pulses may be submitted from any thread, they are played from update()
+	HapticsScheduler& getHaptics() { return haptics; }
+	// delays the start of each frame's work after WaitGetPoses, see FramePacer
+	FramePacer& getFramePacer() { return framePacer; }
+	// motion-to-photon measurement of every frame, off by default as it costs extra pose queries
+	void setLatencyMeasurement(bool enabled) { measureLatency = enabled; }
+	const LatencyHarness& getLatencyHarness() const { return latencyHarness; }
+	void resetLatencyHarness() { latencyHarness.reset(); }
+	// other systems subscribe here for the VR events they care about
+	VREventBus& getEventBus() { return eventBus; }
+	// set when the runtime asked the application to exit
+	bool isQuitRequested() const { return quitRequested; }
+	// the user is in the dashboard or another application has focus, optional work can be skipped
+	bool shouldReduceRenderingWork() const { return reduceRenderingWork; }
 	void submit(uint32_t leftEyeTexture, uint32_t rightEyeTexture);
 
+	// The compositor's distortion corrected view of an eye as a GL texture shared with this context.
+	// It must only be read between lock and unlock.
+	bool lockMirrorTexture(uint32_t eye, uint32_t& texture);
+	void unlockMirrorTexture(uint32_t eye);
+
+	// Samples the lens distortion to find how many display pixels each render target pixel ends up
+	// covering. Cells that need at least threshold of the peak resolution form the full resolution
+	// center; the periphery is scaled to the highest density it still needs.
+	FoveationLayout computeFoveationLayout(uint32_t eye, float threshold, uint32_t gridSize = 32);
+
+	static glm::mat4 convertOpenVRMatrixToQMatrix(const vr::HmdMatrix34_t &mat);
+
 private:
+	// the benchmarks drive the private pose loop and property lookups directly
+	friend struct OpenVRWrapperBenchmark;
+
 	std::string getTrackedDeviceString(vr::TrackedDeviceIndex_t unDevice, vr::TrackedDeviceProperty prop, vr::TrackedPropertyError* peError = nullptr);
 	glm::mat4 getEyeProjMat(vr::Hmd_Eye nEye, float fNear = 0.1f, float fFar = 100.0f);
 	glm::mat4 getEyeViewMat(vr::Hmd_Eye nEye);
-	glm::mat4 convertOpenVRMatrixToQMatrix(const vr::HmdMatrix34_t &mat);
 
-	void updateInput();
-	void updateTrackedDevicePose();
-	void handleVREvent(const vr::VREvent_t& event);
-	bool getDigitalActionState(vr::VRActionHandle_t action, EDigitalActionStateType digitalActionStateType, vr::VRInputValueHandle_t *pDevicePath = nullptr);
-
-	void loadRenderModel(const char* name, vr::RenderModel_t*& model, vr::RenderModel_TextureMap_t*& texture);
+	void updateInput(float poseSecondsFromNow);
+	void waitTrackedDevicePose();
+	void refreshTrackedDevicePose(float secondsToPhotons);
+	void updateTrackedDeviceMatrices();
+	// seconds from now until the frame being rendered is scanned out, negative if unknown
+	float secondsToTargetVsync();
+	// seconds from now until the frame being rendered is displayed, negative if unknown
+	float predictSecondsToPhotons();
+	// seconds from now until the frame has to be submitted, counted from the same vsync as the
+	// photon prediction so running start and the late poses agree on the frame
+	double predictSecondsToDeadline();
+	void onTrackedDeviceEvents(const vr::VREvent_t* events, uint32_t count);
+	void refreshDeviceRenderModel(vr::TrackedDeviceIndex_t device);
+	void onFocusEvents();
+	void onQuitEvents();
 
 	vr::IVRSystem* system = nullptr;
 	std::string driverName;
@@ -49,12 +106,27 @@ private:
 	vr::TrackedDevicePose_t trackedDevicePose[vr::k_unMaxTrackedDeviceCount];
 	glm::mat4 trackedDeviceModelMat[vr::k_unMaxTrackedDeviceCount];
 	char deviceClassChar[vr::k_unMaxTrackedDeviceCount];
+	static const uint32_t MAX_RENDER_MODEL_NAME = 256;
+	// looked up at init and when a device is activated or updated, never on the pose path; names
+	// are short, one that does not fit is dropped
+	char deviceRenderModel[vr::k_unMaxTrackedDeviceCount][MAX_RENDER_MODEL_NAME];
 
-	vr::VRActionSetHandle_t actionSet = vr::k_ulInvalidActionSetHandle;
-	vr::VRActionHandle_t triggerAction = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t gripAction = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t trackpadAction = vr::k_ulInvalidActionHandle;
-	vr::VRActionHandle_t menuAction = vr::k_ulInvalidActionHandle;
+	InputSystem input;
+	HandSkeleton handSkeleton;
+	HapticsScheduler haptics;
+	FramePacer framePacer;
+	float frameInterval = 0.0f;
+	float vsyncToPhotons = 0.0f;
+	// vsync counter value at which the frame being rendered is scanned out
+	uint64_t targetVsync = 0;
+	// poses were sampled after WaitGetPoses, the compositor is told which one was rendered with
+	bool lateHmdPose = false;
+	OpenVRLatencySource latencySource;
+	LatencyHarness latencyHarness;
+	bool measureLatency = false;
+	VREventBus eventBus;
+	bool quitRequested = false;
+	bool reduceRenderingWork = false;
 
 	bool bTrigger;
 	glm::vec2 trackpad;
@@ -65,4 +137,7 @@ private:
 
 	glm::mat4 eyeViewProjMat[2];
 	glm::mat4 hmdModelMat;
+
+	vr::glUInt_t mirrorTexture[2] = {};
+	vr::glSharedTextureHandle_t mirrorSharedHandle[2] = {};
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+// Measures the overdraw of opaque geometry: GL_SAMPLES_PASSED counts every sample that passes
+// the depth test between begin() and end(), divided by the samples of the render target. Like
+// GpuTimer, results are read back a few frames later from a small ring of queries, so reading
+// never stalls the pipeline. Every sample counted beyond the first per pixel is shading a depth
+// pre-pass would have saved.
+class OverdrawMonitor
+{
+public:
+	static const int QUERY_COUNT = 4;
+
+	void init(float threshold)
+	{
+		this->threshold = threshold;
+		glGenQueries(QUERY_COUNT, queries);
+	}
+
+	void destroy()
+	{
+		glDeleteQueries(QUERY_COUNT, queries);
+	}
+
+	// samples of the render target measured in, width * height * MSAA samples
+	void setTargetSamples(uint64_t samples)
+	{
+		targetSamples = samples;
+	}
+
+	void begin()
+	{
+		querySamples[current % QUERY_COUNT] = targetSamples;
+		glBeginQuery(GL_SAMPLES_PASSED, queries[current % QUERY_COUNT]);
+	}
+
+	void end()
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		current++;
+	}
+
+	// Reads back finished queries, true while the overdraw is above the threshold. It has to fall
+	// well below the threshold to turn off again, so a scene hovering around it doesn't flip every frame.
+	bool update()
+	{
+		while (current - pending > 0)
+		{
+			GLuint query = queries[pending % QUERY_COUNT];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			// the ring is full, the oldest query has to be consumed before it is reused
+			if (!available && current - pending < QUERY_COUNT)
+				break;
+
+			GLuint64 passed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &passed);
+			uint64_t samples = querySamples[pending % QUERY_COUNT];
+			overdraw = samples > 0 ? (float)((double)passed / samples) : 0.0f;
+			pending++;
+		}
+
+		aboveThreshold = overdraw > (aboveThreshold ? threshold * HYSTERESIS : threshold);
+		return aboveThreshold;
+	}
+
+	float getOverdraw() const { return overdraw; }
+	bool isAboveThreshold() const { return aboveThreshold; }
+
+private:
+	// fraction of the threshold the overdraw has to drop below to turn off again
+	static constexpr float HYSTERESIS = 0.8f;
+
+	GLuint queries[QUERY_COUNT];
+	uint64_t querySamples[QUERY_COUNT];
+	int64_t current = 0;
+	int64_t pending = 0;
+	uint64_t targetSamples = 0;
+	float threshold = 0.0f;
+	float overdraw = 0.0f;
+	bool aboveThreshold = false;
+};
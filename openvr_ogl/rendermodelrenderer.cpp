@@ -0,0 +1,418 @@
+#include "rendermodelrenderer.h"
+#include "glstatecache.h"
+#include "streambuffer.h"
+#include "renderqueue.h"
+#include "shader.h"
+#include "clusteredlighting.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
+
+// component slots and texture layers are stored as bytes in the vertices
+static const size_t MAX_MODEL_COMPONENTS = 256;
+
+static glm::mat4 convertComponentMatrix(const vr::HmdMatrix34_t& mat)
+{
+	return glm::mat4(
+		mat.m[0][0], mat.m[1][0], mat.m[2][0], 0.0f,
+		mat.m[0][1], mat.m[1][1], mat.m[2][1], 0.0f,
+		mat.m[0][2], mat.m[1][2], mat.m[2][2], 0.0f,
+		mat.m[0][3], mat.m[1][3], mat.m[2][3], 1.0f
+	);
+}
+
+void RenderModelRenderer::init(uint32_t shaderFeatures)
+{
+	Shader shader;
+	shader.init("asset/shader/rendermodel_vs.glsl", "asset/shader/rendermodel_fs.glsl", nullptr, ShaderPreprocessor::getFeatureDefines(shaderFeatures));
+	program = shader.ID;
+	viewProjLocation = glGetUniformLocation(program, "viewProj");
+	cameraPositionLocation = glGetUniformLocation(program, "cameraPosition");
+	paletteBaseLocation = glGetUniformLocation(program, "paletteBase");
+	componentCountLocation = glGetUniformLocation(program, "componentCount");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "diffuseTexture"), 0);
+	glUniform1i(glGetUniformLocation(program, "paletteBuffer"), RenderQueue::MODEL_TEXTURE_UNIT);
+	ClusteredLighting::setupProgram(program);
+
+	instances.reserve(vr::k_unMaxTrackedDeviceCount);
+}
+
+void RenderModelRenderer::destroy()
+{
+	for (Model& model : models)
+	{
+		releaseParts(model);
+		glDeleteVertexArrays(1, &model.vao);
+		glDeleteBuffers(1, &model.vbo);
+		glDeleteBuffers(1, &model.ebo);
+		glDeleteTextures(1, &model.texture);
+	}
+	models.clear();
+	glDeleteProgram(program);
+	program = 0;
+}
+
+void RenderModelRenderer::add(const char* renderModelName, vr::VRInputValueHandle_t devicePath, const glm::mat4& modelMat)
+{
+	Instance instance;
+	instance.model = findModel(renderModelName);
+	instance.devicePath = devicePath;
+	instance.modelMat = modelMat;
+	instances.push_back(instance);
+}
+
+uint32_t RenderModelRenderer::findModel(const char* name)
+{
+	for (size_t i = 0; i < models.size(); ++i)
+	{
+		if (models[i].name == name)
+		{
+			return (uint32_t)i;
+		}
+	}
+
+	models.emplace_back();
+	models.back().name = name;
+	beginLoad(models.back());
+	return (uint32_t)models.size() - 1;
+}
+
+void RenderModelRenderer::beginLoad(Model& model)
+{
+	const char* name = model.name.c_str();
+	uint32_t componentCount = vr::VRRenderModels()->GetComponentCount(name);
+	if (componentCount == 0)
+	{
+		// a model without components is drawn whole, as a single component that never moves
+		Part part;
+		part.modelName = model.name;
+		model.parts.push_back(part);
+		return;
+	}
+
+	for (uint32_t i = 0; i < componentCount && model.parts.size() < MAX_MODEL_COMPONENTS; ++i)
+	{
+		Part part;
+		part.componentName.resize(vr::VRRenderModels()->GetComponentName(name, i, nullptr, 0));
+		if (part.componentName.empty())
+		{
+			continue;
+		}
+		vr::VRRenderModels()->GetComponentName(name, i, &part.componentName[0], (uint32_t)part.componentName.size());
+		part.componentName.pop_back();
+
+		// components without geometry only provide attachment points
+		part.modelName.resize(vr::VRRenderModels()->GetComponentRenderModelName(name, part.componentName.c_str(), nullptr, 0));
+		if (part.modelName.size() <= 1)
+		{
+			continue;
+		}
+		vr::VRRenderModels()->GetComponentRenderModelName(name, part.componentName.c_str(), &part.modelName[0], (uint32_t)part.modelName.size());
+		part.modelName.pop_back();
+		model.parts.push_back(part);
+	}
+}
+
+bool RenderModelRenderer::pollLoad(Model& model)
+{
+	bool loading = false;
+	for (Part& part : model.parts)
+	{
+		if (part.model || part.failed)
+		{
+			continue;
+		}
+
+		vr::EVRRenderModelError error = vr::VRRenderModels()->LoadRenderModel_Async(part.modelName.c_str(), &part.model);
+		if (error == vr::VRRenderModelError_Loading)
+		{
+			loading = true;
+		}
+		else if (error != vr::VRRenderModelError_None || !part.model)
+		{
+			printf("Failed to load render model %s, error: %s\n", part.modelName.c_str(),
+				vr::VRRenderModels()->GetRenderModelErrorNameFromEnum(error));
+			part.model = nullptr;
+			part.failed = true;
+		}
+		else if (part.model->diffuseTextureId != vr::INVALID_TEXTURE_ID &&
+			std::find(model.textureIds.begin(), model.textureIds.end(), part.model->diffuseTextureId) == model.textureIds.end())
+		{
+			model.textureIds.push_back(part.model->diffuseTextureId);
+			model.textureMaps.push_back(nullptr);
+		}
+	}
+
+	for (size_t i = 0; i < model.textureIds.size(); ++i)
+	{
+		if (model.textureMaps[i] || model.textureIds[i] == vr::INVALID_TEXTURE_ID)
+		{
+			continue;
+		}
+
+		vr::EVRRenderModelError error = vr::VRRenderModels()->LoadTexture_Async(model.textureIds[i], &model.textureMaps[i]);
+		if (error == vr::VRRenderModelError_Loading)
+		{
+			loading = true;
+		}
+		else if (error != vr::VRRenderModelError_None || !model.textureMaps[i])
+		{
+			// the layer stays white
+			printf("Failed to load render model %s's texture id %d\n", model.name.c_str(), model.textureIds[i]);
+			model.textureMaps[i] = nullptr;
+			model.textureIds[i] = vr::INVALID_TEXTURE_ID;
+		}
+	}
+	return !loading;
+}
+
+void RenderModelRenderer::createMesh(Model& model)
+{
+	// all textures of the model become layers of one array sized to the largest of them
+	uint32_t layerWidth = 1;
+	uint32_t layerHeight = 1;
+	for (const vr::RenderModel_TextureMap_t* map : model.textureMaps)
+	{
+		if (map && map->format == vr::VRRenderModelTextureFormat_RGBA8_SRGB)
+		{
+			layerWidth = std::max(layerWidth, (uint32_t)map->unWidth);
+			layerHeight = std::max(layerHeight, (uint32_t)map->unHeight);
+		}
+	}
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	for (const Part& part : model.parts)
+	{
+		if (!part.model)
+		{
+			continue;
+		}
+
+		uint32_t layer = 0;
+		glm::vec2 texCoordScale(1.0f);
+		auto texture = std::find(model.textureIds.begin(), model.textureIds.end(), part.model->diffuseTextureId);
+		if (texture != model.textureIds.end())
+		{
+			layer = (uint32_t)(texture - model.textureIds.begin());
+			const vr::RenderModel_TextureMap_t* map = model.textureMaps[layer];
+			if (map && map->format == vr::VRRenderModelTextureFormat_RGBA8_SRGB)
+			{
+				// smaller textures only fill the corner of their layer
+				texCoordScale = glm::vec2((float)map->unWidth / layerWidth, (float)map->unHeight / layerHeight);
+			}
+		}
+
+		uint32_t baseVertex = (uint32_t)vertices.size();
+		for (uint32_t i = 0; i < part.model->unVertexCount; ++i)
+		{
+			const vr::RenderModel_Vertex_t& source = part.model->rVertexData[i];
+			Vertex vertex = {};
+			vertex.position = glm::vec3(source.vPosition.v[0], source.vPosition.v[1], source.vPosition.v[2]);
+			vertex.normal = glm::vec3(source.vNormal.v[0], source.vNormal.v[1], source.vNormal.v[2]);
+			vertex.texCoord = glm::vec2(source.rfTextureCoord[0], source.rfTextureCoord[1]) * texCoordScale;
+			vertex.component = (uint8_t)model.components.size();
+			vertex.layer = (uint8_t)layer;
+			vertices.push_back(vertex);
+		}
+		for (uint32_t i = 0; i < part.model->unTriangleCount * 3; ++i)
+		{
+			indices.push_back(baseVertex + part.model->rIndexData[i]);
+		}
+		model.components.push_back(part.componentName);
+	}
+	model.indexCount = (GLsizei)indices.size();
+
+	glGenVertexArrays(1, &model.vao);
+	glGenBuffers(1, &model.vbo);
+	glGenBuffers(1, &model.ebo);
+	glBindVertexArray(model.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, model.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
+	glEnableVertexAttribArray(2);
+	glVertexAttribIPointer(3, 2, GL_UNSIGNED_BYTE, sizeof(Vertex), (void*)offsetof(Vertex, component));
+	glEnableVertexAttribArray(3);
+	glBindVertexArray(0);
+
+	GLsizei layerCount = (GLsizei)std::max<size_t>(model.textureIds.size(), 1);
+	std::vector<uint8_t> white(layerWidth * layerHeight * 4, 255);
+	glGenTextures(1, &model.texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, model.texture);
+	// the runtime delivers sRGB encoded maps, sampling has to decode them to linear
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_SRGB8_ALPHA8, layerWidth, layerHeight, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	for (GLsizei layer = 0; layer < layerCount; ++layer)
+	{
+		const vr::RenderModel_TextureMap_t* map = layer < (GLsizei)model.textureMaps.size() ? model.textureMaps[layer] : nullptr;
+		bool supported = map && map->format == vr::VRRenderModelTextureFormat_RGBA8_SRGB;
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, supported ? map->unWidth : layerWidth, supported ? map->unHeight : layerHeight, 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, supported ? map->rubTextureMapData : white.data());
+	}
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
+
+void RenderModelRenderer::releaseParts(Model& model)
+{
+	for (Part& part : model.parts)
+	{
+		if (part.model)
+		{
+			vr::VRRenderModels()->FreeRenderModel(part.model);
+		}
+	}
+	for (vr::RenderModel_TextureMap_t* map : model.textureMaps)
+	{
+		if (map)
+		{
+			vr::VRRenderModels()->FreeTexture(map);
+		}
+	}
+	model.parts.clear();
+	model.textureIds.clear();
+	model.textureMaps.clear();
+}
+
+bool RenderModelRenderer::upload(GLStateCache& glState, StreamBuffer& stream)
+{
+	lastDrawCount = 0;
+	lastComponentCount = 0;
+
+	bool created = false;
+	for (Model& model : models)
+	{
+		model.instanceCount = 0;
+		model.paletteBase = -1;
+		if (model.state == ModelState_Loading && pollLoad(model))
+		{
+			bool loaded = std::any_of(model.parts.begin(), model.parts.end(), [](const Part& part) { return part.model != nullptr; });
+			if (loaded)
+			{
+				createMesh(model);
+				created = true;
+			}
+			model.state = loaded ? ModelState_Ready : ModelState_Failed;
+			// the runtime's copies are no longer needed once uploaded
+			releaseParts(model);
+		}
+	}
+	if (created)
+	{
+		glState.invalidate();
+	}
+
+	size_t matrixCount = 0;
+	for (const Instance& instance : instances)
+	{
+		Model& model = models[instance.model];
+		if (model.state == ModelState_Ready)
+		{
+			model.instanceCount++;
+			matrixCount += model.components.size();
+		}
+	}
+	if (matrixCount == 0)
+	{
+		instances.clear();
+		return false;
+	}
+
+	StreamAllocation allocation;
+	if (!stream.allocate(matrixCount * sizeof(glm::mat4), sizeof(glm::mat4), allocation))
+	{
+		printf("Stream buffer is out of space for %zu render model components\n", matrixCount);
+		instances.clear();
+		return false;
+	}
+
+	// one pass over the devices of each model, so each model's palettes are contiguous and
+	// every component's state is queried exactly once per device
+	glm::mat4* palette = (glm::mat4*)allocation.data;
+	int32_t base = (int32_t)(allocation.offset / sizeof(glm::mat4));
+	vr::RenderModel_ControllerMode_State_t controllerMode = {};
+	for (uint32_t i = 0; i < models.size(); ++i)
+	{
+		Model& model = models[i];
+		if (model.instanceCount == 0)
+		{
+			continue;
+		}
+
+		model.paletteBase = base;
+		for (const Instance& instance : instances)
+		{
+			if (instance.model != i)
+			{
+				continue;
+			}
+
+			for (const std::string& component : model.components)
+			{
+				// devices without input (trackers, base stations) skip the query, their components never move
+				vr::RenderModel_ComponentState_t state;
+				if (component.empty() || instance.devicePath == vr::k_ulInvalidInputValueHandle ||
+					!vr::VRRenderModels()->GetComponentStateForDevicePath(model.name.c_str(), component.c_str(),
+					instance.devicePath, &controllerMode, &state))
+				{
+					// no state to animate by, drawn where the model places it
+					*palette++ = instance.modelMat;
+				}
+				else if (state.uProperties & vr::VRComponentProperty_IsVisible)
+				{
+					*palette++ = instance.modelMat * convertComponentMatrix(state.mTrackingToComponentRenderModel);
+				}
+				else
+				{
+					// collapses the component to a point, its triangles are discarded before rasterization
+					*palette++ = glm::mat4(0.0f);
+				}
+			}
+		}
+		base += (int32_t)(model.instanceCount * model.components.size());
+		lastDrawCount++;
+	}
+	lastComponentCount = (uint32_t)matrixCount;
+
+	paletteTexture = stream.getTexture();
+	instances.clear();
+	return true;
+}
+
+void RenderModelRenderer::draw(GLStateCache& glState, const glm::mat4& viewProjMat, const glm::vec3& viewPosition)
+{
+	if (lastDrawCount == 0)
+	{
+		return;
+	}
+
+	glState.useProgram(program);
+	glState.bindTexture(RenderQueue::MODEL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, paletteTexture);
+	glUniformMatrix4fv(viewProjLocation, 1, GL_FALSE, glm::value_ptr(viewProjMat));
+	glUniform3fv(cameraPositionLocation, 1, glm::value_ptr(viewPosition));
+	for (const Model& model : models)
+	{
+		if (model.paletteBase < 0)
+		{
+			continue;
+		}
+
+		glState.bindVertexArray(model.vao);
+		glState.bindTexture(0, GL_TEXTURE_2D_ARRAY, model.texture);
+		glUniform1i(paletteBaseLocation, model.paletteBase);
+		glUniform1i(componentCountLocation, (GLint)model.components.size());
+		// one instance per device showing this model
+		glDrawElementsInstanced(GL_TRIANGLES, model.indexCount, GL_UNSIGNED_INT, nullptr, model.instanceCount);
+	}
+}
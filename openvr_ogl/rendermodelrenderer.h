@@ -0,0 +1,113 @@
+#pragma once
+
+#include <openvr.h>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class GLStateCache;
+class StreamBuffer;
+
+// Draws OpenVR render models split into their components (buttons, trigger, trackpad, ...), so
+// they animate with the input state. All components of a model are packed into one mesh whose
+// vertices carry their component slot and texture layer. Every frame upload() queries each queued
+// device's component transforms in one pass and writes them into the stream buffer as a matrix
+// palette; draw() then renders every device using the same model with a single instanced call,
+// the instance selecting the device's palette. Animated devices cost the same CPU as static ones.
+//
+// Models load asynchronously on first use, devices are skipped until their model is ready.
+class RenderModelRenderer
+{
+public:
+	void init(uint32_t shaderFeatures);
+	void destroy();
+
+	// queues a device for this frame. devicePath is the input source the component states are
+	// read for, vr::k_ulInvalidInputValueHandle for devices without input components.
+	void add(const char* renderModelName, vr::VRInputValueHandle_t devicePath, const glm::mat4& modelMat);
+	// false if no queued device has its model ready, nothing is drawn then. Finishing a model's
+	// load creates its GL objects behind the back of glState, which is invalidated then.
+	bool upload(GLStateCache& glState, StreamBuffer& stream);
+	void draw(GLStateCache& glState, const glm::mat4& viewProjMat, const glm::vec3& viewPosition);
+
+	// instanced draws and component matrices of the last upload()
+	uint32_t getLastDrawCount() const { return lastDrawCount; }
+	uint32_t getLastComponentCount() const { return lastComponentCount; }
+
+private:
+	enum EModelState
+	{
+		ModelState_Loading,
+		ModelState_Ready,
+		ModelState_Failed
+	};
+
+	struct Vertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texCoord;
+		// palette slot of the component and layer of its texture
+		uint8_t component;
+		uint8_t layer;
+		uint8_t padding[2];
+	};
+
+	// a component with geometry while its mesh and texture are loading
+	struct Part
+	{
+		std::string componentName;
+		std::string modelName;
+		vr::RenderModel_t* model = nullptr;
+		bool failed = false;
+	};
+
+	struct Model
+	{
+		std::string name;
+		EModelState state = ModelState_Loading;
+		// components with geometry in palette order, empty names for models without components
+		std::vector<std::string> components;
+		std::vector<Part> parts;
+		std::vector<vr::TextureID_t> textureIds;
+		std::vector<vr::RenderModel_TextureMap_t*> textureMaps;
+
+		GLuint vao = 0;
+		GLuint vbo = 0;
+		GLuint ebo = 0;
+		GLuint texture = 0;
+		GLsizei indexCount = 0;
+
+		// devices drawing this model this frame and their palette
+		uint32_t instanceCount = 0;
+		int32_t paletteBase = -1;
+	};
+
+	struct Instance
+	{
+		uint32_t model;
+		vr::VRInputValueHandle_t devicePath;
+		glm::mat4 modelMat;
+	};
+
+	uint32_t findModel(const char* name);
+	void beginLoad(Model& model);
+	bool pollLoad(Model& model);
+	void createMesh(Model& model);
+	void releaseParts(Model& model);
+
+	GLuint program = 0;
+	GLint viewProjLocation = -1;
+	GLint cameraPositionLocation = -1;
+	GLint paletteBaseLocation = -1;
+	GLint componentCountLocation = -1;
+
+	std::vector<Model> models;
+	std::vector<Instance> instances;
+	GLuint paletteTexture = 0;
+	uint32_t lastDrawCount = 0;
+	uint32_t lastComponentCount = 0;
+};
@@ -0,0 +1,296 @@
+#include "renderqueue.h"
+#include "glstatecache.h"
+#include "streambuffer.h"
+#include "overdrawmonitor.h"
+#include "clusteredlighting.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <string.h>
+
+uint64_t DrawKey::make(uint32_t pass, uint32_t eye, uint32_t shader, uint32_t material, uint32_t texture, uint32_t depth)
+{
+	uint64_t key = pass & ((1u << PASS_BITS) - 1);
+	key = (key << EYE_BITS) | (eye & ((1u << EYE_BITS) - 1));
+	key = (key << SHADER_BITS) | (shader & ((1u << SHADER_BITS) - 1));
+	key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+	key = (key << TEXTURE_BITS) | (texture & ((1u << TEXTURE_BITS) - 1));
+	key = (key << DEPTH_BITS) | (depth & ((1u << DEPTH_BITS) - 1));
+	return key;
+}
+
+uint32_t DrawKey::quantizeDepth(float distance, float maxDistance, bool backToFront)
+{
+	const uint32_t maxDepth = (1u << DEPTH_BITS) - 1;
+	float normalized = std::min(std::max(distance / maxDistance, 0.0f), 1.0f);
+	uint32_t depth = (uint32_t)(normalized * maxDepth);
+	return backToFront ? maxDepth - depth : depth;
+}
+
+void RenderQueue::clear()
+{
+	keys.clear();
+	packets.clear();
+	transforms.clear();
+	modelBase = -1;
+}
+
+void RenderQueue::submit(uint64_t key, const DrawPacket& packet, const glm::mat4& modelMat)
+{
+	keys.push_back(key);
+	packets.push_back(packet);
+	packets.back().transformIndex = (uint32_t)transforms.size();
+	transforms.push_back(modelMat);
+}
+
+void RenderQueue::resize(size_t count)
+{
+	keys.resize(count);
+	packets.resize(count);
+	transforms.resize(count);
+}
+
+void RenderQueue::write(size_t index, uint64_t key, const DrawPacket& packet, const glm::mat4& modelMat)
+{
+	keys[index] = key;
+	packets[index] = packet;
+	packets[index].transformIndex = (uint32_t)index;
+	transforms[index] = modelMat;
+}
+
+static uint32_t findOrAppend(std::vector<GLuint>& names, GLuint name)
+{
+	std::vector<GLuint>::iterator found = std::find(names.begin(), names.end(), name);
+	if (found != names.end())
+	{
+		return (uint32_t)(found - names.begin());
+	}
+	names.push_back(name);
+	return (uint32_t)names.size() - 1;
+}
+
+uint32_t RenderQueue::registerMaterial(GLuint program, GLuint texture)
+{
+	for (size_t i = 0; i < materials.size(); ++i)
+	{
+		if (materials[i].program == program && materials[i].texture == texture)
+		{
+			return (uint32_t)i;
+		}
+	}
+
+	Material material = { program, texture, findOrAppend(shaderNames, program), findOrAppend(textureNames, texture) };
+	if (material.shaderId >= (1u << DrawKey::SHADER_BITS) || material.textureId >= (1u << DrawKey::TEXTURE_BITS) ||
+		materials.size() >= (1u << DrawKey::MATERIAL_BITS))
+	{
+		throw std::runtime_error("Too many programs, textures or materials for the draw sort key");
+	}
+	materials.push_back(material);
+	return (uint32_t)materials.size() - 1;
+}
+
+void RenderQueue::clearMaterials()
+{
+	materials.clear();
+	shaderNames.clear();
+	textureNames.clear();
+}
+
+uint64_t RenderQueue::makeKey(uint32_t pass, uint32_t eye, uint32_t material, uint32_t depth) const
+{
+	const Material& ids = materials[material];
+	return DrawKey::make(pass, eye, ids.shaderId, material, ids.textureId, depth);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = keys.size();
+	sortedKeys.assign(keys.begin(), keys.end());
+	keyScratch.resize(count);
+	order.resize(count);
+	orderScratch.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		order[i] = i;
+	}
+
+	// LSD radix sort, one byte per pass; passes where every key shares the byte are skipped,
+	// so the unused high bits of typical keys cost nothing
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t histogram[256] = { 0 };
+		for (size_t i = 0; i < count; ++i)
+		{
+			histogram[(sortedKeys[i] >> shift) & 0xFF]++;
+		}
+
+		if (count == 0 || histogram[(sortedKeys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t& bucket : histogram)
+		{
+			uint32_t bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t dst = histogram[(sortedKeys[i] >> shift) & 0xFF]++;
+			keyScratch[dst] = sortedKeys[i];
+			orderScratch[dst] = order[i];
+		}
+
+		sortedKeys.swap(keyScratch);
+		order.swap(orderScratch);
+	}
+}
+
+bool RenderQueue::upload(StreamBuffer& stream)
+{
+	modelBase = -1;
+	StreamAllocation allocation;
+	if (!stream.allocate(transforms.size() * sizeof(glm::mat4), sizeof(glm::mat4), allocation))
+	{
+		printf("Stream buffer is out of space for %zu model matrices\n", transforms.size());
+		return false;
+	}
+
+	memcpy(allocation.data, transforms.data(), transforms.size() * sizeof(glm::mat4));
+	modelTexture = stream.getTexture();
+	modelBase = (int32_t)(allocation.offset / sizeof(glm::mat4));
+	return true;
+}
+
+void RenderQueue::execute(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat, const glm::vec3& viewPosition, OverdrawMonitor* overdraw)
+{
+	lastDrawCount = 0;
+	lastPrepassDrawCount = 0;
+	if (modelBase < 0)
+	{
+		return;
+	}
+
+	glState.bindTexture(MODEL_TEXTURE_UNIT, GL_TEXTURE_BUFFER, modelTexture);
+	if (overdraw)
+	{
+		overdraw->begin();
+	}
+	executeDepthPrepass(glState, eye, viewProjMat);
+	// the draws without a pre-pass are depth tested as usual, so with the pre-pass they count every
+	// sample that would have been shaded without it
+	executeShading(glState, eye, viewProjMat, viewPosition, false);
+	if (overdraw)
+	{
+		overdraw->end();
+	}
+
+	if (lastPrepassDrawCount > 0)
+	{
+		// the pre-pass already wrote the final depth, only the samples that survived it are shaded
+		glState.depthFunc(GL_EQUAL);
+		glState.depthMask(false);
+		executeShading(glState, eye, viewProjMat, viewPosition, true);
+		glState.depthFunc(GL_LESS);
+		glState.depthMask(true);
+	}
+}
+
+bool RenderQueue::isDrawnForEye(size_t sorted, uint32_t eye) const
+{
+	uint32_t drawEye = DrawKey::getEye(sortedKeys[sorted]);
+	return drawEye == DrawEye_Both || drawEye == eye + 1;
+}
+
+bool RenderQueue::isDepthPrepassed(size_t sorted) const
+{
+	const DrawPacket& packet = packets[order[sorted]];
+	return depthProgram != 0 && DrawKey::getPass(sortedKeys[sorted]) == RenderPass_Opaque &&
+		(packet.depthPrepass == DepthPrepass_Always || (packet.depthPrepass == DepthPrepass_Auto && autoDepthPrepass));
+}
+
+void RenderQueue::executeDepthPrepass(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat)
+{
+	const ProgramUniforms* uniforms = nullptr;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		if (!isDrawnForEye(i, eye) || !isDepthPrepassed(i))
+		{
+			continue;
+		}
+
+		if (!uniforms)
+		{
+			glState.colorMask(false);
+			glState.useProgram(depthProgram);
+			uniforms = &getProgramUniforms(depthProgram);
+			glUniformMatrix4fv(uniforms->viewProj, 1, GL_FALSE, glm::value_ptr(viewProjMat));
+		}
+
+		const DrawPacket& packet = packets[order[i]];
+		glState.bindVertexArray(packet.depthVao ? packet.depthVao : packet.vao);
+		glUniform1i(uniforms->modelIndex, modelBase + (GLint)packet.transformIndex);
+		glDrawArrays(GL_TRIANGLES, packet.first, packet.count);
+		lastPrepassDrawCount++;
+	}
+
+	if (uniforms)
+	{
+		glState.colorMask(true);
+	}
+}
+
+void RenderQueue::executeShading(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat, const glm::vec3& viewPosition, bool prepassed)
+{
+	const ProgramUniforms* uniforms = nullptr;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		if (!isDrawnForEye(i, eye) || isDepthPrepassed(i) != prepassed)
+		{
+			continue;
+		}
+
+		const DrawPacket& packet = packets[order[i]];
+		if (!uniforms || uniforms->program != packet.program)
+		{
+			// per-view uniforms only need to be set when the program changes
+			glState.useProgram(packet.program);
+			uniforms = &getProgramUniforms(packet.program);
+			glUniformMatrix4fv(uniforms->viewProj, 1, GL_FALSE, glm::value_ptr(viewProjMat));
+			glUniform3fv(uniforms->cameraPosition, 1, glm::value_ptr(viewPosition));
+		}
+
+		glState.bindVertexArray(packet.vao);
+		glState.bindTexture(0, GL_TEXTURE_2D, packet.texture);
+		glUniform1i(uniforms->modelIndex, modelBase + (GLint)packet.transformIndex);
+		glDrawArrays(GL_TRIANGLES, packet.first, packet.count);
+		lastDrawCount++;
+	}
+}
+
+const RenderQueue::ProgramUniforms& RenderQueue::getProgramUniforms(GLuint program)
+{
+	for (const ProgramUniforms& uniforms : programUniforms)
+	{
+		if (uniforms.program == program)
+		{
+			return uniforms;
+		}
+	}
+
+	ProgramUniforms uniforms;
+	uniforms.program = program;
+	uniforms.modelIndex = glGetUniformLocation(program, "modelIndex");
+	// only called with the program bound, the sampler unit never changes
+	glUniform1i(glGetUniformLocation(program, "modelBuffer"), MODEL_TEXTURE_UNIT);
+	ClusteredLighting::setupProgram(program);
+	uniforms.viewProj = glGetUniformLocation(program, "viewProj");
+	uniforms.cameraPosition = glGetUniformLocation(program, "cameraPosition");
+	programUniforms.push_back(uniforms);
+	return programUniforms.back();
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+class GLStateCache;
+class StreamBuffer;
+class OverdrawMonitor;
+
+enum ERenderPass : uint32_t
+{
+	RenderPass_Opaque = 0,
+	RenderPass_Transparent = 1
+};
+
+enum EDrawEye : uint32_t
+{
+	DrawEye_Both = 0,
+	DrawEye_Left = 1,
+	DrawEye_Right = 2
+};
+
+// 64-bit sort key, most significant field first:
+// | pass:4 | eye:2 | shader:10 | material:12 | texture:12 | depth:24 |
+// Sorting by key groups draws by pass, then by the most expensive state to change. Shader,
+// material and texture are the dense ids RenderQueue::registerMaterial() assigns, not GL names.
+struct DrawKey
+{
+	static const int DEPTH_BITS = 24;
+	static const int TEXTURE_BITS = 12;
+	static const int MATERIAL_BITS = 12;
+	static const int SHADER_BITS = 10;
+	static const int EYE_BITS = 2;
+	static const int PASS_BITS = 4;
+
+	static uint64_t make(uint32_t pass, uint32_t eye, uint32_t shader, uint32_t material, uint32_t texture, uint32_t depth);
+	// Maps a view distance in [0, maxDistance] to the depth field; transparent draws sort back to front.
+	static uint32_t quantizeDepth(float distance, float maxDistance, bool backToFront = false);
+	static uint32_t getPass(uint64_t key) { return (uint32_t)(key >> (64 - PASS_BITS)); }
+	static uint32_t getEye(uint64_t key) { return (uint32_t)(key >> (64 - PASS_BITS - EYE_BITS)) & ((1u << EYE_BITS) - 1); }
+};
+
+// Per material choice of a depth-only pre-pass for opaque draws. Pre-passed draws lay down
+// depth first and are then shaded with GL_EQUAL, so an expensive fragment shader runs once
+// per sample instead of once for every overdrawn fragment.
+enum EDepthPrepass : uint32_t
+{
+	DepthPrepass_Never = 0,
+	DepthPrepass_Always = 1,
+	// pre-passed only while RenderQueue::setAutoDepthPrepass() is on, see OverdrawMonitor
+	DepthPrepass_Auto = 2
+};
+
+// Built with brace lists that name every field; extend all of them when adding one, a missing
+// field would silently be zero
+struct DrawPacket
+{
+	GLuint program;
+	GLuint vao;
+	GLuint texture;
+	GLint first;
+	GLsizei count;
+	uint32_t transformIndex;
+	// EDepthPrepass, and a position only vertex array for the pre-pass; 0 draws it from vao
+	uint32_t depthPrepass;
+	GLuint depthVao;
+	// RenderQueue::registerMaterial() of program and texture
+	uint32_t material;
+};
+
+// Collects draw packets for one frame, radix sorts them once by key and replays the sorted
+// list for each eye, only touching GL state where consecutive packets differ. Model matrices
+// are streamed to the GPU once per frame and fetched by the vertex shader from a texture buffer
+// bound to MODEL_TEXTURE_UNIT, so a draw only sets the index of its matrix.
+class RenderQueue
+{
+public:
+	static const GLuint MODEL_TEXTURE_UNIT = 1;
+
+	void clear();
+	void submit(uint64_t key, const DrawPacket& packet, const glm::mat4& modelMat);
+	// Alternative to submit() for filling the queue from several threads: resize once, then
+	// every thread writes its own range of slots
+	void resize(size_t count);
+	void write(size_t index, uint64_t key, const DrawPacket& packet, const glm::mat4& modelMat);
+	void sort();
+
+	// Gives a program and texture pair, and each of them, small dense ids for the sort key; GL
+	// names would be cut to the key's fields and could alias. Registering a pair again returns
+	// the same material. Throws once a field runs out of ids.
+	uint32_t registerMaterial(GLuint program, GLuint texture);
+	// forgets all materials, for when their programs and textures were deleted
+	void clearMaterials();
+	// DrawKey::make() with the ids of a registered material
+	uint64_t makeKey(uint32_t pass, uint32_t eye, uint32_t material, uint32_t depth) const;
+	// Writes the model matrices into this frame's region of the stream buffer. Call after the
+	// queue is filled and before execute(); nothing is drawn if it fails.
+	bool upload(StreamBuffer& stream);
+	// eye is 0 for left and 1 for right, matching vr::Hmd_Eye. With an overdraw monitor, the
+	// samples passing the depth test are counted up to the GL_EQUAL shading of pre-passed draws.
+	void execute(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat, const glm::vec3& viewPosition, OverdrawMonitor* overdraw = nullptr);
+
+	// Position only program drawing the depth pre-pass, built from depth_vs.glsl; no draw is
+	// pre-passed without one
+	void setDepthPrepassProgram(GLuint program) { depthProgram = program; }
+	// whether DepthPrepass_Auto packets are pre-passed
+	void setAutoDepthPrepass(bool enabled) { autoDepthPrepass = enabled; }
+
+	size_t getPacketCount() const { return keys.size(); }
+	uint32_t getLastDrawCount() const { return lastDrawCount; }
+	uint32_t getLastPrepassDrawCount() const { return lastPrepassDrawCount; }
+
+private:
+	struct Material
+	{
+		GLuint program;
+		GLuint texture;
+		uint32_t shaderId;
+		uint32_t textureId;
+	};
+
+	struct ProgramUniforms
+	{
+		GLuint program;
+		GLint modelIndex;
+		GLint viewProj;
+		GLint cameraPosition;
+	};
+
+	const ProgramUniforms& getProgramUniforms(GLuint program);
+	bool isDrawnForEye(size_t sorted, uint32_t eye) const;
+	bool isDepthPrepassed(size_t sorted) const;
+	void executeDepthPrepass(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat);
+	// shades either the pre-passed draws or all others
+	void executeShading(GLStateCache& glState, uint32_t eye, const glm::mat4& viewProjMat, const glm::vec3& viewPosition, bool prepassed);
+
+	std::vector<uint64_t> keys;
+	std::vector<DrawPacket> packets;
+	std::vector<glm::mat4> transforms;
+
+	// sorted order of packets, plus scratch space reused between frames
+	std::vector<uint64_t> sortedKeys;
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> orderScratch;
+	std::vector<uint64_t> keyScratch;
+
+	std::vector<Material> materials;
+	// indexed by shader and texture id
+	std::vector<GLuint> shaderNames;
+	std::vector<GLuint> textureNames;
+
+	std::vector<ProgramUniforms> programUniforms;
+	GLuint modelTexture = 0;
+	// index of the first matrix in the texture buffer, -1 if not uploaded this frame
+	int32_t modelBase = -1;
+	uint32_t lastDrawCount = 0;
+
+	GLuint depthProgram = 0;
+	bool autoDepthPrepass = false;
+	uint32_t lastPrepassDrawCount = 0;
+};
@@ -5,80 +5,31 @@
 #include <glm/glm.hpp>
 
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
+#include <map>
 #include <iostream>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include "shaderpreprocessor.h"
 
 class Shader
 {
 public:
     unsigned int ID;
 
-	void init(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+	void init(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const std::vector<std::string>& defines = {})
 	{
-		// 1. retrieve the vertex/fragment source code from filePath
-		std::string vertexCode;
-		std::string fragmentCode;
-		std::string geometryCode;
-		std::ifstream vShaderFile;
-		std::ifstream fShaderFile;
-		std::ifstream gShaderFile;
-		// ensure ifstream objects can throw exceptions:
-		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		try
-		{
-			// open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
-			// if geometry shader path is present, also load a geometry shader
-			if (geometryPath != nullptr)
-			{
-				gShaderFile.open(geometryPath);
-				std::stringstream gShaderStream;
-				gShaderStream << gShaderFile.rdbuf();
-				gShaderFile.close();
-				geometryCode = gShaderStream.str();
-			}
-		}
-		catch (std::ifstream::failure& e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << e.code().message() << std::endl;
-		}
-		const char* vShaderCode = vertexCode.c_str();
-		const char * fShaderCode = fragmentCode.c_str();
-		// 2. compile shaders
-		unsigned int vertex, fragment;
-		// vertex shader
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		checkCompileErrors(vertex, "VERTEX");
-		// fragment Shader
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		checkCompileErrors(fragment, "FRAGMENT");
+		// retrieve each stage's source code from filePath, resolving #include and injecting defines,
+		// and compile it while the preprocessor still knows which files it was made of
+		ShaderPreprocessor preprocessor;
+		unsigned int vertex = compileStage(preprocessor, vertexPath, GL_VERTEX_SHADER, "VERTEX", defines);
+		unsigned int fragment = compileStage(preprocessor, fragmentPath, GL_FRAGMENT_SHADER, "FRAGMENT", defines);
 		// if geometry shader is given, compile geometry shader
-		unsigned int geometry;
+		unsigned int geometry = 0;
 		if (geometryPath != nullptr)
 		{
-			const char * gShaderCode = geometryCode.c_str();
-			geometry = glCreateShader(GL_GEOMETRY_SHADER);
-			glShaderSource(geometry, 1, &gShaderCode, NULL);
-			glCompileShader(geometry);
-			checkCompileErrors(geometry, "GEOMETRY");
+			geometry = compileStage(preprocessor, geometryPath, GL_GEOMETRY_SHADER, "GEOMETRY", defines);
 		}
 		// shader Program
 		ID = glCreateProgram();
@@ -161,9 +112,48 @@ public:
     }
 
 private:
+	unsigned int compileStage(ShaderPreprocessor& preprocessor, const char* path, GLenum stage, const char* type, const std::vector<std::string>& defines)
+	{
+		std::string code = preprocessor.process(path, defines);
+		const char* shaderCode = code.c_str();
+		unsigned int shader = glCreateShader(stage);
+		glShaderSource(shader, 1, &shaderCode, NULL);
+		glCompileShader(shader);
+		checkCompileErrors(shader, type, preprocessor.getSourceFiles());
+		return shader;
+	}
+
+	// Compilers report errors as "<source>(<line>)" or "<source>:<line>", with the source string
+	// numbers set by the preprocessor's #line directives; swaps each number for its file name.
+	static std::string mapSourceFiles(const std::string& log, const std::vector<std::string>& sourceFiles)
+	{
+		std::string mapped;
+		size_t lineStart = 0;
+		while (lineStart < log.size())
+		{
+			size_t lineEnd = log.find('\n', lineStart);
+			lineEnd = lineEnd == std::string::npos ? log.size() : lineEnd + 1;
+			std::string line = log.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd;
+
+			// the number comes first, or after a severity prefix such as "ERROR: "
+			size_t numberStart = line.find_first_of("0123456789");
+			size_t numberEnd = numberStart == std::string::npos ? std::string::npos : line.find_first_not_of("0123456789", numberStart);
+			bool located = numberStart != std::string::npos && numberStart < 16 && numberEnd + 1 < line.size() &&
+				(line[numberEnd] == '(' || line[numberEnd] == ':') && isdigit((unsigned char)line[numberEnd + 1]);
+			size_t source = located ? (size_t)atoi(line.c_str() + numberStart) : 0;
+			if (located && source < sourceFiles.size())
+			{
+				line.replace(numberStart, numberEnd - numberStart, sourceFiles[source]);
+			}
+			mapped += line;
+		}
+		return mapped;
+	}
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    void checkCompileErrors(GLuint shader, std::string type, const std::vector<std::string>& sourceFiles = {})
     {
         GLint success;
         GLchar infoLog[1024];
@@ -173,7 +163,7 @@ private:
             if(!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << mapSourceFiles(infoLog, sourceFiles) << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
         else
@@ -187,4 +177,40 @@ private:
         }
     }
 };
+
+// Lazily compiled permutations of one vertex/fragment pair, keyed by an EShaderFeature bitmask
+class ShaderVariants
+{
+public:
+    void init(const char* vertexPath, const char* fragmentPath)
+    {
+        this->vertexPath = vertexPath;
+        this->fragmentPath = fragmentPath;
+    }
+
+    Shader& get(uint32_t featureMask)
+    {
+        auto iter = variants.find(featureMask);
+        if (iter == variants.end())
+        {
+            iter = variants.emplace(featureMask, Shader()).first;
+            iter->second.init(vertexPath.c_str(), fragmentPath.c_str(), nullptr, ShaderPreprocessor::getFeatureDefines(featureMask));
+        }
+        return iter->second;
+    }
+
+    void destroy()
+    {
+        for (auto& variant : variants)
+        {
+            glDeleteProgram(variant.second.ID);
+        }
+        variants.clear();
+    }
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::map<uint32_t, Shader> variants;
+};
 #endif
@@ -0,0 +1,147 @@
+#include "shaderpreprocessor.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+static const int MAX_INCLUDE_DEPTH = 16;
+
+static const char* const FEATURE_DEFINES[ShaderFeature_Count] =
+{
+	"ENABLE_SPECULAR",
+	"CLUSTERED_LIGHTING"
+};
+
+std::string ShaderPreprocessor::process(const std::string& path, const std::vector<std::string>& defines)
+{
+	sourceFiles.clear();
+	includedFiles.clear();
+
+	std::string source;
+	if (!readFile(path, source))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return "";
+	}
+	sourceFiles.push_back(path);
+	includedFiles.insert(path);
+
+	// #version must stay the first statement, so the defines go right after it
+	std::string header;
+	size_t versionPos = source.find("#version");
+	if (versionPos != std::string::npos)
+	{
+		size_t versionEnd = source.find('\n', versionPos);
+		versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+		header = source.substr(0, versionEnd);
+		source.erase(0, versionEnd);
+	}
+
+	std::string out = header;
+	for (const std::string& define : defines)
+	{
+		out += "#define " + define + "\n";
+	}
+
+	int firstLine = 1;
+	for (char c : header)
+	{
+		if (c == '\n')
+			firstLine++;
+	}
+	out += "#line " + std::to_string(firstLine) + " 0\n";
+
+	appendLines(path, source, 0, firstLine, out, 0);
+
+	return out;
+}
+
+std::vector<std::string> ShaderPreprocessor::getFeatureDefines(uint32_t featureMask)
+{
+	std::vector<std::string> defines;
+	for (uint32_t i = 0; i < ShaderFeature_Count; ++i)
+	{
+		if (featureMask & (1u << i))
+		{
+			defines.push_back(FEATURE_DEFINES[i]);
+		}
+	}
+	return defines;
+}
+
+void ShaderPreprocessor::expand(const std::string& path, std::string& out, int depth)
+{
+	if (depth > MAX_INCLUDE_DEPTH)
+	{
+		std::cout << "ERROR::SHADER::INCLUDE_TOO_DEEP " << path << std::endl;
+		return;
+	}
+
+	// every include behaves as if guarded by #pragma once
+	if (!includedFiles.insert(path).second)
+	{
+		return;
+	}
+
+	std::string source;
+	if (!readFile(path, source))
+	{
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+		return;
+	}
+
+	int sourceIndex = (int)sourceFiles.size();
+	sourceFiles.push_back(path);
+	out += "#line 1 " + std::to_string(sourceIndex) + "\n";
+
+	appendLines(path, source, sourceIndex, 1, out, depth);
+}
+
+void ShaderPreprocessor::appendLines(const std::string& path, const std::string& source, int sourceIndex, int firstLine, std::string& out, int depth)
+{
+	std::istringstream stream(source);
+	std::string line;
+	int lineNumber = firstLine;
+	while (std::getline(stream, line))
+	{
+		lineNumber++;
+		size_t includePos = line.find("#include");
+		if (includePos == std::string::npos || line.find_first_not_of(" \t") != includePos)
+		{
+			out += line + "\n";
+			continue;
+		}
+
+		size_t begin = line.find('"', includePos);
+		size_t end = begin == std::string::npos ? std::string::npos : line.find('"', begin + 1);
+		if (end == std::string::npos)
+		{
+			std::cout << "ERROR::SHADER::MALFORMED_INCLUDE " << path << ":" << lineNumber - 1 << std::endl;
+			continue;
+		}
+
+		expand(getDirectory(path) + line.substr(begin + 1, end - begin - 1), out, depth + 1);
+		// resume numbering in the including file after the inlined text
+		out += "#line " + std::to_string(lineNumber) + " " + std::to_string(sourceIndex) + "\n";
+	}
+}
+
+bool ShaderPreprocessor::readFile(const std::string& path, std::string& out)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	out = stream.str();
+	return true;
+}
+
+std::string ShaderPreprocessor::getDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <stdint.h>
+
+// Compile-time feature toggles, combined into a bitmask to select a shader permutation
+enum EShaderFeature : uint32_t
+{
+	ShaderFeature_None = 0,
+	ShaderFeature_Specular = 1 << 0,
+	ShaderFeature_ClusteredLighting = 1 << 1,
+
+	ShaderFeature_Count = 2
+};
+
+class ShaderPreprocessor
+{
+public:
+	// Returns the fully expanded source of the file at path: every #include "file" is inlined
+	// (relative to the including file, each file at most once) and the given defines are
+	// injected right after the #version directive.
+	std::string process(const std::string& path, const std::vector<std::string>& defines = {});
+
+	// The files that made up the last processed source, indexed by the source string number
+	// used in the emitted #line directives, so compile errors can be mapped back to a file.
+	const std::vector<std::string>& getSourceFiles() const { return sourceFiles; }
+
+	static std::vector<std::string> getFeatureDefines(uint32_t featureMask);
+
+private:
+	void expand(const std::string& path, std::string& out, int depth);
+	void appendLines(const std::string& path, const std::string& source, int sourceIndex, int firstLine, std::string& out, int depth);
+	bool readFile(const std::string& path, std::string& out);
+	std::string getDirectory(const std::string& path);
+
+	std::vector<std::string> sourceFiles;
+	std::set<std::string> includedFiles;
+};
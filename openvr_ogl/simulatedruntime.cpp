@@ -0,0 +1,194 @@
+#include "simulatedruntime.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+static const double PI = 3.14159265358979323846;
+// head turning left and right and swaying, amplitudes in radians and meters, frequencies in Hz
+static const double YAW_AMPLITUDE = 0.8;
+static const double YAW_FREQUENCY = 0.5;
+static const double SWAY_AMPLITUDE = 0.05;
+static const double SWAY_FREQUENCY = 0.3;
+// nominal frame cost and how often a frame spikes to several times it
+static const double CPU_TIME = 0.003;
+static const double GPU_TIME = 0.005;
+static const double SPIKE_PROBABILITY = 0.03;
+
+SimulatedRuntime::SimulatedRuntime(double refreshRate, uint32_t seed)
+	: frameInterval(1.0 / refreshRate), random(seed)
+{
+	memset(timings, 0, sizeof(timings));
+}
+
+void SimulatedRuntime::getMotion(double at, glm::vec3& position, float& yaw, glm::vec3& velocity, float& yawRate) const
+{
+	double yawPhase = 2.0 * PI * YAW_FREQUENCY * at;
+	double swayPhase = 2.0 * PI * SWAY_FREQUENCY * at;
+	yaw = (float)(YAW_AMPLITUDE * std::sin(yawPhase));
+	yawRate = (float)(YAW_AMPLITUDE * 2.0 * PI * YAW_FREQUENCY * std::cos(yawPhase));
+	position = glm::vec3((float)(SWAY_AMPLITUDE * std::sin(swayPhase)), 1.7f, 0.0f);
+	velocity = glm::vec3((float)(SWAY_AMPLITUDE * 2.0 * PI * SWAY_FREQUENCY * std::cos(swayPhase)), 0.0f, 0.0f);
+
+	if (path.empty())
+	{
+		return;
+	}
+
+	// the sway and head turn stay relative to where the path is heading
+	glm::vec3 pathPosition, direction;
+	getPathPosition(at, pathPosition, direction);
+	float heading = std::atan2(-direction.x, -direction.z);
+	float c = std::cos(heading);
+	float s = std::sin(heading);
+	position = pathPosition + glm::vec3(c * position.x, position.y, -s * position.x);
+	velocity = direction * pathSpeed + glm::vec3(c * velocity.x, 0.0f, -s * velocity.x);
+	yaw += heading;
+}
+
+void SimulatedRuntime::setPath(const std::vector<glm::vec3>& waypoints, float speed)
+{
+	path = waypoints;
+	pathSpeed = speed;
+	pathDistance.assign(1, 0.0f);
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		pathDistance.push_back(pathDistance.back() + glm::length(path[(i + 1) % path.size()] - path[i]));
+	}
+}
+
+void SimulatedRuntime::getPathPosition(double at, glm::vec3& position, glm::vec3& direction) const
+{
+	position = path[0];
+	direction = glm::vec3(0.0f, 0.0f, -1.0f);
+	float length = pathDistance.back();
+	if (length <= 0.0f)
+	{
+		return;
+	}
+
+	float distance = (float)std::fmod(at * pathSpeed, (double)length);
+	size_t segment = std::upper_bound(pathDistance.begin(), pathDistance.end(), distance) - pathDistance.begin() - 1;
+	segment = std::min(segment, path.size() - 1);
+	const glm::vec3& from = path[segment];
+	const glm::vec3& to = path[(segment + 1) % path.size()];
+	float segmentLength = pathDistance[segment + 1] - pathDistance[segment];
+	if (segmentLength > 0.0f)
+	{
+		direction = (to - from) / segmentLength;
+		position = from + direction * (distance - pathDistance[segment]);
+	}
+}
+
+vr::HmdMatrix34_t SimulatedRuntime::makePose(const glm::vec3& position, float yaw)
+{
+	float c = std::cos(yaw);
+	float s = std::sin(yaw);
+	vr::HmdMatrix34_t pose = { {
+		{ c, 0.0f, s, position.x },
+		{ 0.0f, 1.0f, 0.0f, position.y },
+		{ -s, 0.0f, c, position.z },
+	} };
+	return pose;
+}
+
+bool SimulatedRuntime::getHmdPose(float secondsFromNow, vr::HmdMatrix34_t& pose)
+{
+	glm::vec3 position, velocity;
+	float yaw, yawRate;
+	if (secondsFromNow <= 0.0f)
+	{
+		// the present and past are known exactly
+		getMotion(time + secondsFromNow, position, yaw, velocity, yawRate);
+		pose = makePose(position, yaw);
+		return true;
+	}
+
+	// the future is extrapolated from the current velocity, which is where prediction error comes from
+	getMotion(time, position, yaw, velocity, yawRate);
+	pose = makePose(position + velocity * secondsFromNow, yaw + yawRate * secondsFromNow);
+	return true;
+}
+
+void SimulatedRuntime::waitGetPoses(vr::HmdMatrix34_t& renderPose, float& predictedSecondsToPhotons)
+{
+	// the first running start not already passed; a frame that overran waits for the next one
+	double vsync = std::ceil((time + runningStart) / frameInterval) * frameInterval;
+	time = std::max(time, vsync - runningStart);
+
+	vr::Compositor_FrameTiming& timing = timings[timingCount++ % TIMING_HISTORY];
+	memset(&timing, 0, sizeof(timing));
+	timing.m_nSize = sizeof(timing);
+	timing.m_nFrameIndex = ++frameIndex;
+	timing.m_flSystemTimeInSeconds = vsync;
+	timing.m_flNewPosesReadyMs = (float)((time - vsync) * 1000.0);
+
+	// predicted for the vsync after the upcoming one, where the frame is meant to be displayed
+	predictedSecondsToPhotons = (float)(vsync + frameInterval + vsyncToPhotons - time);
+	getHmdPose(predictedSecondsToPhotons, renderPose);
+	timing.m_HmdPose.mDeviceToAbsoluteTracking = renderPose;
+}
+
+void SimulatedRuntime::advance(double seconds)
+{
+	time += seconds;
+}
+
+void SimulatedRuntime::submit(double gpuSeconds)
+{
+	vr::Compositor_FrameTiming& timing = timings[(timingCount - 1) % TIMING_HISTORY];
+	double vsync = timing.m_flSystemTimeInSeconds;
+	timing.m_flNewFrameReadyMs = (float)((time - vsync) * 1000.0);
+	timing.m_flPreSubmitGpuMs = (float)(gpuSeconds * 1000.0);
+
+	// displayed on the first vsync the GPU work and the compositor pass both fit before
+	double gpuDone = time + gpuSeconds;
+	uint32_t vsyncs = std::max(1, (int)std::ceil((gpuDone + compositorTime - vsync) / frameInterval - 1e-9));
+	timing.m_nNumVSyncsToFirstView = vsyncs;
+	timing.m_nNumMisPresented = vsyncs > 1 ? 1 : 0;
+	timing.m_nNumFramePresents = 1;
+}
+
+uint32_t SimulatedRuntime::getLastVsyncCount() const
+{
+	return timingCount > 0 ? timings[(timingCount - 1) % TIMING_HISTORY].m_nNumVSyncsToFirstView : 0;
+}
+
+bool SimulatedRuntime::getCurrentFrameIndex(uint32_t& frameIndex)
+{
+	frameIndex = this->frameIndex;
+	return true;
+}
+
+uint32_t SimulatedRuntime::getFrameTimings(vr::Compositor_FrameTiming* timings, uint32_t count)
+{
+	// only frames already on screen are reported, like the compositor does; the newest are
+	// collected and then put oldest first
+	uint32_t filled = 0;
+	uint32_t available = timingCount < TIMING_HISTORY ? timingCount : TIMING_HISTORY;
+	for (uint32_t i = 1; i <= available && filled < count; ++i)
+	{
+		const vr::Compositor_FrameTiming& timing = this->timings[(timingCount - i) % TIMING_HISTORY];
+		double displayed = timing.m_flSystemTimeInSeconds + timing.m_nNumVSyncsToFirstView * frameInterval;
+		if (timing.m_nNumFramePresents > 0 && displayed <= time)
+		{
+			timings[filled++] = timing;
+		}
+	}
+	std::reverse(timings, timings + filled);
+	return filled;
+}
+
+double SimulatedRuntime::sampleCpuTime()
+{
+	std::uniform_real_distribution<double> jitter(0.8, 1.2);
+	std::uniform_real_distribution<double> spike(0.0, 1.0);
+	return CPU_TIME * jitter(random) * (spike(random) < SPIKE_PROBABILITY ? 3.0 : 1.0);
+}
+
+double SimulatedRuntime::sampleGpuTime()
+{
+	std::uniform_real_distribution<double> jitter(0.8, 1.2);
+	std::uniform_real_distribution<double> spike(0.0, 1.0);
+	return GPU_TIME * jitter(random) * (spike(random) < SPIKE_PROBABILITY ? 2.0 : 1.0);
+}
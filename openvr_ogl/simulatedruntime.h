@@ -0,0 +1,69 @@
+#pragma once
+
+#include "latencyharness.h"
+
+#include <random>
+#include <vector>
+#include <stdint.h>
+
+// Headless stand-in for the compositor, on a virtual clock that only moves when told to. It
+// runs vsyncs at a fixed rate with a running start before each, predicts the HMD pose the way
+// the runtime does (extrapolating the current velocity) for a head turning and swaying
+// sinusoidally, and displays a frame on the first vsync its GPU work finishes in time for.
+// With a path set the head also walks along it, facing the direction of travel.
+// Lets the latency harness and the stress benchmark run without a headset, reproducibly.
+class SimulatedRuntime : public LatencySource
+{
+public:
+	static const uint32_t TIMING_HISTORY = 32;
+
+	SimulatedRuntime(double refreshRate = 90.0, uint32_t seed = 1);
+
+	// advances to the next running start, returns the render pose and its prediction time
+	void waitGetPoses(vr::HmdMatrix34_t& renderPose, float& predictedSecondsToPhotons);
+	// the application's CPU work between WaitGetPoses and submit
+	void advance(double seconds);
+	// submits the frame with gpuSeconds of GPU work still to run
+	void submit(double gpuSeconds);
+
+	double getTime() override { return time; }
+	double getFrameInterval() override { return frameInterval; }
+	double getVsyncToPhotons() override { return vsyncToPhotons; }
+	bool getCurrentFrameIndex(uint32_t& frameIndex) override;
+	uint32_t getFrameTimings(vr::Compositor_FrameTiming* timings, uint32_t count) override;
+	bool getHmdPose(float secondsFromNow, vr::HmdMatrix34_t& pose) override;
+
+	// Walks a closed loop through waypoints at speed meters per second, starting at the first;
+	// an empty list stands still at the origin
+	void setPath(const std::vector<glm::vec3>& waypoints, float speed);
+	// vsyncs between the last submitted frame's running start and it being displayed, 1 if on time
+	uint32_t getLastVsyncCount() const;
+
+	// randomized CPU and GPU frame cost with occasional spikes, for driving the simulation
+	double sampleCpuTime();
+	double sampleGpuTime();
+
+private:
+	// the simulated head motion at a given time, and its derivative
+	void getMotion(double at, glm::vec3& position, float& yaw, glm::vec3& velocity, float& yawRate) const;
+	static vr::HmdMatrix34_t makePose(const glm::vec3& position, float yaw);
+	void getPathPosition(double at, glm::vec3& position, glm::vec3& direction) const;
+
+	double frameInterval;
+	double vsyncToPhotons = 0.0111;
+	double runningStart = 0.003;
+	// time the compositor needs before the vsync a frame is displayed on
+	double compositorTime = 0.001;
+	double time = 0.0;
+
+	std::vector<glm::vec3> path;
+	// distance along the path at each waypoint, the last entry closes the loop
+	std::vector<float> pathDistance;
+	float pathSpeed = 0.0f;
+
+	uint32_t frameIndex = 0;
+	vr::Compositor_FrameTiming timings[TIMING_HISTORY];
+	uint32_t timingCount = 0;
+
+	std::mt19937 random;
+};
@@ -0,0 +1,237 @@
+#include "streambuffer.h"
+#include "glstatecache.h"
+
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+
+// not part of the GL 3.3 loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (GLAD_API_PTR *PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+static PFNBUFFERSTORAGEPROC loadBufferStorage()
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 4);
+
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount && !supported; ++i)
+	{
+		supported = strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+	}
+
+	return supported ? (PFNBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage") : nullptr;
+}
+
+void StreamBuffer::init(size_t frameSize, uint32_t frameCount)
+{
+	if (frameCount == 0 || frameCount > MAX_FRAMES)
+	{
+		printf("Stream buffer frame count %u clamped to [1, %u]\n", frameCount, MAX_FRAMES);
+		frameCount = frameCount == 0 ? 1 : MAX_FRAMES;
+	}
+	this->frameCount = frameCount;
+
+	// GL 3.3 only guarantees 65536 texels, a frame of 1 MB in a ring of three would not fit
+	GLint maxTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	maxFrameSize = (size_t)maxTexels * TEXEL_SIZE / frameCount / 256 * 256;
+	if (frameSize > maxFrameSize)
+	{
+		printf("Stream buffer frames of %zu KB shrunk to %zu KB to fit %d texture buffer texels\n", frameSize / 1024, maxFrameSize / 1024, maxTexels);
+		frameSize = maxFrameSize;
+	}
+	this->frameSize = frameSize;
+	limitReported = false;
+	create();
+	printf("Stream buffer: %u frames of %zu KB, %s\n", frameCount, frameSize / 1024,
+		persistent ? "persistently mapped" : "mapped per frame");
+}
+
+void StreamBuffer::destroy()
+{
+	release();
+}
+
+void StreamBuffer::create()
+{
+	frame = 0;
+	head = 0;
+	generation++;
+	GLsizeiptr size = (GLsizeiptr)(frameSize * frameCount);
+
+	// the copy write target is free for this, so no cached binding is disturbed
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+	static PFNBUFFERSTORAGEPROC bufferStorage = loadBufferStorage();
+	persistent = bufferStorage != nullptr;
+	if (persistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+		persistentData = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		if (!persistentData)
+		{
+			printf("Failed to map stream buffer persistently\n");
+			persistent = false;
+			glDeleteBuffers(1, &buffer);
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		}
+	}
+	if (!persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	}
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+}
+
+void StreamBuffer::release()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+		{
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+
+	if (persistentData || mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &buffer);
+	buffer = texture = 0;
+	persistentData = frameData = nullptr;
+	mapped = false;
+}
+
+void StreamBuffer::beginFrame(GLStateCache& glState)
+{
+	if (requiredFrameSize > frameSize && frameSize == maxFrameSize)
+	{
+		if (!limitReported)
+		{
+			printf("Stream buffer needs %zu KB per frame, the texture buffer limit allows %zu KB\n", requiredFrameSize / 1024, maxFrameSize / 1024);
+			limitReported = true;
+		}
+	}
+	else if (requiredFrameSize > frameSize)
+	{
+		// release() waits for the GPU to finish with every region
+		size_t newSize = frameSize;
+		while (newSize < requiredFrameSize)
+		{
+			newSize *= 2;
+		}
+		newSize = newSize < maxFrameSize ? newSize : maxFrameSize;
+		printf("Stream buffer grows from %zu KB to %zu KB per frame\n", frameSize / 1024, newSize / 1024);
+		release();
+		frameSize = newSize;
+		create();
+		glState.invalidate();
+	}
+	requiredFrameSize = 0;
+
+	frame = (frame + 1) % frameCount;
+	head = frameBegin();
+
+	bool orphan = false;
+	GLsync& fence = fences[frame];
+	if (fence)
+	{
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			stallCount++;
+			if (persistent)
+			{
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			}
+			else
+			{
+				orphan = true;
+			}
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if (persistent)
+	{
+		frameData = persistentData + frameBegin();
+		return;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (orphan)
+	{
+		// the driver hands out fresh storage while the GPU keeps reading the old one
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(frameSize * frameCount), nullptr, GL_STREAM_DRAW);
+	}
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+	frameData = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, frameBegin(), frameSize, access);
+	mapped = frameData != nullptr;
+	if (!mapped)
+	{
+		printf("Failed to map stream buffer frame %u\n", frame);
+	}
+}
+
+bool StreamBuffer::allocate(size_t size, size_t alignment, StreamAllocation& allocation)
+{
+	size_t offset = (head + alignment - 1) / alignment * alignment;
+	size_t end = offset + size;
+	if (!frameData || end > frameBegin() + frameSize)
+	{
+		requiredFrameSize = (requiredFrameSize ? requiredFrameSize : getFrameUsage()) + size + alignment;
+		return false;
+	}
+
+	head = end;
+	allocation.data = frameData + (offset - frameBegin());
+	allocation.offset = (GLintptr)offset;
+	allocation.size = (GLsizeiptr)size;
+	return true;
+}
+
+void StreamBuffer::commit()
+{
+	if (mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		mapped = false;
+	}
+	if (!persistent)
+	{
+		frameData = nullptr;
+	}
+}
+
+void StreamBuffer::endFrame()
+{
+	lastFrameUsage = getFrameUsage();
+	commit();
+	if (fences[frame])
+	{
+		glDeleteSync(fences[frame]);
+	}
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+#include <stddef.h>
+
+class GLStateCache;
+
+struct StreamAllocation
+{
+	// CPU pointer straight into the GPU visible buffer, write only
+	void* data = nullptr;
+	// byte offset of the allocation in getBuffer()
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+// One large buffer for data written every frame (uniforms, instance data, dynamic vertices),
+// split into frameCount regions used round robin. A region is handed out again only once the
+// fence placed after the frame that used it has signaled, so writes never race the GPU and the
+// driver never has to copy or rename anything.
+//
+// With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistently and coherently.
+// Otherwise each frame's region is mapped unsynchronized in beginFrame() and unmapped in
+// commit(); the buffer is orphaned instead of waited on if the GPU is still reading the region.
+//
+// Shaders fetch from texture buffer views over the whole buffer, so all regions together stay
+// within GL_MAX_TEXTURE_BUFFER_SIZE texels: larger frame sizes are shrunk to fit, and growth
+// stops at the limit.
+class StreamBuffer
+{
+public:
+	void init(size_t frameSize, uint32_t frameCount = 3);
+	void destroy();
+
+	// Growing the buffer recreates its texture behind the back of glState, which is invalidated then
+	void beginFrame(GLStateCache& glState);
+	// Sub-allocates from the current frame's region, false if it is full. The region is grown
+	// at the next beginFrame() so the frame after fits.
+	bool allocate(size_t size, size_t alignment, StreamAllocation& allocation);
+	// all writes for this frame are done, call before drawing with them
+	void commit();
+	// call after the last draw reading this frame's data
+	void endFrame();
+
+	GLuint getBuffer() const { return buffer; }
+	// goes up whenever the buffer is recreated; the new one often reuses the old name, so views
+	// created elsewhere have to compare this rather than getBuffer()
+	uint32_t getGeneration() const { return generation; }
+	// GL_RGBA32F texture buffer over the whole buffer, for fetching float data in shaders
+	GLuint getTexture() const { return texture; }
+	bool isPersistent() const { return persistent; }
+	size_t getFrameUsage() const { return head - frameBegin(); }
+	// what the last frame to reach endFrame() used
+	size_t getLastFrameUsage() const { return lastFrameUsage; }
+	size_t getFrameSize() const { return frameSize; }
+	// beginFrame() calls that had to block on the GPU (persistent) or orphan the buffer (fallback)
+	uint32_t getStallCount() const { return stallCount; }
+
+private:
+	static const uint32_t MAX_FRAMES = 4;
+	// bytes per texel of the RGBA32F and RGBA32UI views
+	static const size_t TEXEL_SIZE = 16;
+
+	void create();
+	void release();
+	size_t frameBegin() const { return frame * frameSize; }
+
+	size_t frameSize = 0;
+	uint32_t frameCount = 0;
+	uint32_t frame = 0;
+	size_t head = 0;
+	size_t requiredFrameSize = 0;
+	size_t lastFrameUsage = 0;
+	// largest frame size the texture buffer views can cover
+	size_t maxFrameSize = 0;
+	bool limitReported = false;
+	uint32_t stallCount = 0;
+	uint32_t generation = 0;
+
+	bool persistent = false;
+	bool mapped = false;
+	GLuint buffer = 0;
+	GLuint texture = 0;
+	uint8_t* persistentData = nullptr;
+	uint8_t* frameData = nullptr;
+	GLsync fences[MAX_FRAMES] = {};
+};
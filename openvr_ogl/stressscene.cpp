@@ -0,0 +1,211 @@
+#include "stressscene.h"
+#include "drawlist.h"
+#include "shader.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <random>
+#include <cmath>
+
+// instances per square meter of ground, and the height of the layer they are scattered over
+static const float INSTANCE_DENSITY = 0.05f;
+static const float LAYER_HEIGHT = 20.0f;
+static const float MIN_SCALE = 0.5f;
+static const float MAX_SCALE = 2.0f;
+static const uint32_t TEXTURE_SIZE = 64;
+static const uint32_t CHECKER_SIZE = 8;
+// half the side of the square camera path, at most, so it stays among the instances
+static const float PATH_HALF_SIZE = 30.0f;
+
+void StressScene::build(RenderQueue& queue, uint32_t instanceCount, uint32_t meshCount, uint32_t materialCount, ShaderVariants& shaders, uint32_t shaderFeatures, uint32_t seed)
+{
+	destroy();
+	buildMeshes(meshCount > 0 ? meshCount : 1);
+	buildMaterials(queue, materialCount > 0 ? materialCount : 1, shaders, shaderFeatures);
+
+	extent = 0.5f * std::sqrt(instanceCount / INSTANCE_DENSITY);
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> horizontal(-extent, extent);
+	std::uniform_real_distribution<float> vertical(0.0f, LAYER_HEIGHT);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> scale(MIN_SCALE, MAX_SCALE);
+	std::uniform_int_distribution<uint32_t> mesh(0, getMeshCount() - 1);
+	std::uniform_int_distribution<uint32_t> material(0, getMaterialCount() - 1);
+
+	instances.reserve(instanceCount);
+	packets.reserve(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		glm::vec3 position(horizontal(random), vertical(random), horizontal(random));
+		glm::quat rotation = glm::angleAxis(angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+		instances.push_back(transforms.create(INVALID_TRANSFORM, position, rotation, glm::vec3(scale(random))));
+
+		uint32_t meshIndex = mesh(random);
+		uint32_t materialIndex = material(random);
+		DrawPacket packet = { programs[materialIndex], vao, textures[materialIndex], meshFirst[meshIndex], meshVertexCount[meshIndex], 0,
+			materialDepthPrepass[materialIndex], depthVao, materialIds[materialIndex] };
+		packets.push_back(packet);
+	}
+	transforms.update();
+
+	std::vector<AABB> bounds;
+	bounds.reserve(instanceCount);
+	for (TransformHandle instance : instances)
+	{
+		bounds.push_back(AABB::fromTransformedUnitCube(transforms.getWorldMatrix(instance)));
+	}
+	bvh.build(bounds);
+}
+
+void StressScene::destroy()
+{
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteVertexArrays(1, &depthVao);
+	glDeleteBuffers(1, &positionVbo);
+	if (!textures.empty())
+	{
+		glDeleteTextures((GLsizei)textures.size(), textures.data());
+	}
+	vao = vbo = depthVao = positionVbo = 0;
+	totalVertexCount = 0;
+	meshFirst.clear();
+	meshVertexCount.clear();
+	textures.clear();
+	programs.clear();
+	materialDepthPrepass.clear();
+	materialIds.clear();
+
+	transforms.clear();
+	instances.clear();
+	packets.clear();
+	bvh = BVH();
+	extent = 0.0f;
+}
+
+void StressScene::buildMeshes(uint32_t meshCount)
+{
+	// the unit cube with every face split into n * n quads, n growing with the mesh index, so
+	// the meshes share bounds but not vertex cost; same layout as the demo cube
+	std::vector<float> vertices;
+	std::vector<glm::vec3> positions;
+	for (uint32_t mesh = 0; mesh < meshCount; ++mesh)
+	{
+		uint32_t n = mesh + 1;
+		meshFirst.push_back((GLint)(vertices.size() / 8));
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				glm::vec3 normal(0.0f);
+				normal[axis] = (float)sign;
+				// u and v span the face, ordered so the triangles wind counter-clockwise seen from outside
+				glm::vec3 u(0.0f), v(0.0f);
+				u[(axis + 1) % 3] = 1.0f;
+				v[(axis + 2) % 3] = (float)sign;
+				for (uint32_t y = 0; y < n; ++y)
+				{
+					for (uint32_t x = 0; x < n; ++x)
+					{
+						const float corners[6][2] = {
+							{ 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f },
+							{ 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f },
+						};
+						for (const float* corner : corners)
+						{
+							float s = (x + corner[0]) / n;
+							float t = (y + corner[1]) / n;
+							glm::vec3 position = 0.5f * normal + (s - 0.5f) * u + (t - 0.5f) * v;
+							const float vertex[8] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, s, t };
+							vertices.insert(vertices.end(), vertex, vertex + 8);
+							positions.push_back(position);
+						}
+					}
+				}
+			}
+		}
+		meshVertexCount.push_back((GLsizei)(vertices.size() / 8) - meshFirst.back());
+	}
+	totalVertexCount = (GLsizei)(vertices.size() / 8);
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	// a tightly packed copy of the positions for the depth pre-pass, which reads nothing else
+	glGenVertexArrays(1, &depthVao);
+	glGenBuffers(1, &positionVbo);
+	glBindVertexArray(depthVao);
+	glBindBuffer(GL_ARRAY_BUFFER, positionVbo);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
+void StressScene::buildMaterials(RenderQueue& queue, uint32_t materialCount, ShaderVariants& shaders, uint32_t shaderFeatures)
+{
+	std::vector<uint8_t> pixels(TEXTURE_SIZE * TEXTURE_SIZE * 3);
+	textures.resize(materialCount);
+	glGenTextures((GLsizei)materialCount, textures.data());
+	for (uint32_t material = 0; material < materialCount; ++material)
+	{
+		// a checkerboard of white and a color walking around the hue circle
+		float hue = 6.2831853f * material / materialCount;
+		glm::vec3 color = 0.5f + 0.5f * glm::vec3(std::cos(hue), std::cos(hue - 2.0943951f), std::cos(hue + 2.0943951f));
+		for (uint32_t y = 0; y < TEXTURE_SIZE; ++y)
+		{
+			for (uint32_t x = 0; x < TEXTURE_SIZE; ++x)
+			{
+				bool white = ((x / CHECKER_SIZE) + (y / CHECKER_SIZE)) % 2 == 0;
+				uint8_t* pixel = &pixels[(y * TEXTURE_SIZE + x) * 3];
+				for (int c = 0; c < 3; ++c)
+				{
+					pixel[c] = white ? 255 : (uint8_t)(color[c] * 255.0f);
+				}
+			}
+		}
+
+		glBindTexture(GL_TEXTURE_2D, textures[material]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TEXTURE_SIZE, TEXTURE_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		// every other material is matte, so shader switches show up in the sorted queue too; only
+		// the specular ones are costly enough to be worth a depth pre-pass
+		bool specular = material % 2 == 0;
+		programs.push_back(shaders.get(specular ? shaderFeatures : shaderFeatures & ~ShaderFeature_Specular).ID);
+		materialDepthPrepass.push_back(specular ? DepthPrepass_Auto : DepthPrepass_Never);
+		materialIds.push_back(queue.registerMaterial(programs.back(), textures[material]));
+	}
+}
+
+void StressScene::buildRenderQueue(JobSystem& jobs, RenderQueue& queue, FrameVector<uint32_t>& visible, const Frustum& frustum, const glm::vec3& viewPosition)
+{
+	visible.reserve(instances.size());
+	cullScene(jobs, bvh, frustum, subtreeVisible, visible);
+	generateDrawPackets(jobs, queue, visible, instances, transforms, packets, viewPosition);
+	queue.sort();
+}
+
+std::vector<glm::vec3> StressScene::getCameraPath() const
+{
+	float halfSize = std::min(extent * 0.8f, PATH_HALF_SIZE);
+	return {
+		glm::vec3(-halfSize, 0.0f, halfSize),
+		glm::vec3(halfSize, 0.0f, halfSize),
+		glm::vec3(halfSize, 0.0f, -halfSize),
+		glm::vec3(-halfSize, 0.0f, -halfSize),
+	};
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "culling.h"
+#include "frameallocator.h"
+#include "renderqueue.h"
+#include "transformsystem.h"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+class ShaderVariants;
+
+// Procedurally populated scene for measuring how the renderer scales with scene size. Static
+// boxes are scattered at a constant density over a flat layer, so a larger scene covers more
+// ground but the view sees about as much of it. Each instance picks one of meshCount meshes,
+// cubes of increasing tessellation sharing one vertex buffer, and one of materialCount
+// materials, a generated texture and a shader variant: the given shader features, matte
+// ones without ShaderFeature_Specular. The specular materials take the depth pre-pass when
+// the render queue enables it automatically, drawn from a position only copy of the meshes.
+class StressScene
+{
+public:
+	// the materials are registered with the queue the scene is drawn with
+	void build(RenderQueue& queue, uint32_t instanceCount, uint32_t meshCount, uint32_t materialCount, ShaderVariants& shaders, uint32_t shaderFeatures, uint32_t seed = 1);
+	void destroy();
+
+	// Culls against the frustum and fills the queue with the visible instances, sorted.
+	// visible must come from the current frame's arena.
+	void buildRenderQueue(JobSystem& jobs, RenderQueue& queue, FrameVector<uint32_t>& visible, const Frustum& frustum, const glm::vec3& viewPosition);
+
+	// a closed loop through the middle of the scene, for SimulatedRuntime::setPath
+	std::vector<glm::vec3> getCameraPath() const;
+
+	uint32_t getInstanceCount() const { return (uint32_t)instances.size(); }
+	uint32_t getMeshCount() const { return (uint32_t)meshFirst.size(); }
+	uint32_t getMaterialCount() const { return (uint32_t)textures.size(); }
+	// vertices of all meshes, each drawn with its own count
+	GLsizei getTotalVertexCount() const { return totalVertexCount; }
+
+private:
+	void buildMeshes(uint32_t meshCount);
+	void buildMaterials(RenderQueue& queue, uint32_t materialCount, ShaderVariants& shaders, uint32_t shaderFeatures);
+
+	TransformSystem transforms;
+	std::vector<TransformHandle> instances;
+	// one per instance, indexed like instances
+	std::vector<DrawPacket> packets;
+	BVH bvh;
+	std::vector<std::vector<uint32_t>> subtreeVisible;
+	float extent = 0.0f;
+
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	GLuint depthVao = 0;
+	GLuint positionVbo = 0;
+	GLsizei totalVertexCount = 0;
+	std::vector<GLint> meshFirst;
+	std::vector<GLsizei> meshVertexCount;
+	std::vector<GLuint> textures;
+	std::vector<GLuint> programs;
+	std::vector<uint32_t> materialDepthPrepass;
+	std::vector<uint32_t> materialIds;
+};
@@ -0,0 +1,102 @@
+#include "textureswapchain.h"
+
+#include <stdio.h>
+
+void TextureSwapchain::init(uint32_t width, uint32_t height, uint32_t length)
+{
+	if (length == 0 || length > MAX_LENGTH)
+	{
+		printf("Swapchain length %u clamped to [1, %u]\n", length, MAX_LENGTH);
+		length = length == 0 ? 1 : MAX_LENGTH;
+	}
+	this->length = length;
+	current = 0;
+	stallCount = 0;
+
+	glGenFramebuffers(length, framebuffers);
+	glGenTextures(length, textures);
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+	}
+}
+
+void TextureSwapchain::destroy()
+{
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		if (fences[i])
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+	glDeleteFramebuffers(length, framebuffers);
+	glDeleteTextures(length, textures);
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		framebuffers[i] = textures[i] = 0;
+	}
+	length = 0;
+}
+
+void TextureSwapchain::attachDepth(GLuint renderbuffer)
+{
+	for (uint32_t i = 0; i < length; ++i)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer);
+	}
+}
+
+void TextureSwapchain::acquire()
+{
+	// a single texture is simply reused, as there is nothing else to move on to
+	if (length < 2)
+	{
+		return;
+	}
+
+	// the oldest texture first, its fence is normally long signaled by now; polled without
+	// flushing, Submit has flushed the commands it waits for
+	uint32_t next = (current + 1) % length;
+	for (uint32_t i = 1; i <= length; ++i)
+	{
+		uint32_t candidate = (current + i) % length;
+		if (!fences[candidate] || glClientWaitSync(fences[candidate], 0, 0) != GL_TIMEOUT_EXPIRED)
+		{
+			next = candidate;
+			break;
+		}
+		if (i == length)
+		{
+			stallCount++;
+		}
+	}
+
+	current = next;
+	if (fences[current])
+	{
+		glDeleteSync(fences[current]);
+		fences[current] = 0;
+	}
+}
+
+void TextureSwapchain::release()
+{
+	if (length < 2)
+	{
+		return;
+	}
+
+	if (fences[current])
+	{
+		glDeleteSync(fences[current]);
+	}
+	fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stdint.h>
+
+// A ring of color textures, each with its own framebuffer, for images handed to the compositor.
+// Every frame acquire() moves on to the next texture and release() fences it right after
+// Submit. The runtime reads OpenGL textures with commands it issues on the submitting context
+// during Submit, so the fence signals once the compositor's read of the texture has completed.
+// acquire() only polls the fences and never blocks: it skips textures still being read, and if
+// all of them are, it takes the next one anyway. Commands on this context run in order, so
+// rendering into it then simply queues behind the read on the GPU.
+class TextureSwapchain
+{
+public:
+	static const uint32_t MAX_LENGTH = 3;
+
+	void init(uint32_t width, uint32_t height, uint32_t length);
+	void destroy();
+
+	// attaches a depth buffer to the framebuffers of all textures
+	void attachDepth(GLuint renderbuffer);
+
+	void acquire();
+	// call right after the current texture has been submitted
+	void release();
+
+	GLuint getFramebuffer() const { return framebuffers[current]; }
+	GLuint getTexture() const { return textures[current]; }
+	uint32_t getLength() const { return length; }
+	// acquires that found every texture still being read by the compositor
+	uint32_t getStallCount() const { return stallCount; }
+
+private:
+	uint32_t length = 0;
+	uint32_t current = 0;
+	uint32_t stallCount = 0;
+
+	GLuint framebuffers[MAX_LENGTH] = {};
+	GLuint textures[MAX_LENGTH] = {};
+	GLsync fences[MAX_LENGTH] = {};
+};
@@ -0,0 +1,134 @@
+#include "transformsystem.h"
+#include "jobsystem.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+
+TransformHandle TransformSystem::create(TransformHandle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	TransformHandle handle = (TransformHandle)this->parent.size();
+	localPosition.push_back(position);
+	localRotation.push_back(rotation);
+	localScale.push_back(scale);
+	worldMat.push_back(glm::mat4(1.0f));
+	this->parent.push_back(parent);
+	depth.push_back(parent != INVALID_TRANSFORM ? depth[parent] + 1 : 0);
+	maxDepth = std::max(maxDepth, depth.back());
+	localDirty.push_back(0);
+	updatedFrame.push_back(0);
+
+	markDirty(handle);
+	return handle;
+}
+
+void TransformSystem::clear()
+{
+	localPosition.clear();
+	localRotation.clear();
+	localScale.clear();
+	worldMat.clear();
+	parent.clear();
+	depth.clear();
+	maxDepth = 0;
+	localDirty.clear();
+	updatedFrame.clear();
+	firstDirty = 0xFFFFFFFF;
+}
+
+void TransformSystem::setLocalPosition(TransformHandle handle, const glm::vec3& position)
+{
+	localPosition[handle] = position;
+	markDirty(handle);
+}
+
+void TransformSystem::setLocalRotation(TransformHandle handle, const glm::quat& rotation)
+{
+	localRotation[handle] = rotation;
+	markDirty(handle);
+}
+
+void TransformSystem::setLocalScale(TransformHandle handle, const glm::vec3& scale)
+{
+	localScale[handle] = scale;
+	markDirty(handle);
+}
+
+void TransformSystem::setLocalRigidMatrix(TransformHandle handle, const glm::mat4& mat)
+{
+	glm::vec3 position(mat[3]);
+	glm::quat rotation = glm::quat_cast(glm::mat3(mat));
+	if (position == localPosition[handle] && rotation == localRotation[handle])
+	{
+		return;
+	}
+
+	localPosition[handle] = position;
+	localRotation[handle] = rotation;
+	markDirty(handle);
+}
+
+void TransformSystem::update(JobSystem* jobs)
+{
+	lastUpdateCount = 0;
+	frame++;
+
+	// everything before the first dirty node is untouched
+	uint32_t count = (uint32_t)parent.size();
+	uint32_t first = firstDirty < count ? firstDirty : count;
+	firstDirty = 0xFFFFFFFF;
+	if (!jobs || jobs->getWorkerCount() <= 1 || count - first < PARALLEL_MIN_NODES || maxDepth >= PARALLEL_MAX_LEVELS)
+	{
+		// since parents precede their children a single forward pass sees every parent's new
+		// world matrix before its children
+		for (uint32_t i = first; i < count; ++i)
+		{
+			lastUpdateCount += updateNode(i) ? 1 : 0;
+		}
+		return;
+	}
+
+	// nodes of one level only read their parents' world matrices, which the previous level's
+	// pass finished, so each level is split into independent chunks
+	std::atomic<uint32_t> updated{ 0 };
+	for (uint32_t level = 0; level <= maxDepth; ++level)
+	{
+		jobs->parallelFor(count - first, PARALLEL_GRAIN, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t chunkUpdated = 0;
+			for (uint32_t i = first + begin; i < first + end; ++i)
+			{
+				if (depth[i] == level && updateNode(i))
+				{
+					chunkUpdated++;
+				}
+			}
+			updated += chunkUpdated;
+		});
+	}
+	lastUpdateCount = updated;
+}
+
+bool TransformSystem::updateNode(uint32_t index)
+{
+	TransformHandle parentHandle = parent[index];
+	bool parentUpdated = parentHandle != INVALID_TRANSFORM && updatedFrame[parentHandle] == frame;
+	if (!localDirty[index] && !parentUpdated)
+	{
+		return false;
+	}
+
+	glm::mat4 localMat = glm::translate(glm::mat4(1.0f), localPosition[index]) * glm::mat4_cast(localRotation[index]);
+	localMat = glm::scale(localMat, localScale[index]);
+	worldMat[index] = parentHandle != INVALID_TRANSFORM ? worldMat[parentHandle] * localMat : localMat;
+
+	localDirty[index] = 0;
+	updatedFrame[index] = frame;
+	return true;
+}
+
+void TransformSystem::markDirty(TransformHandle handle)
+{
+	localDirty[handle] = 1;
+	firstDirty = std::min(firstDirty, handle);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+
+typedef uint32_t TransformHandle;
+const TransformHandle INVALID_TRANSFORM = 0xFFFFFFFF;
+
+// Scene transform hierarchy stored as structure-of-arrays. A node can only be parented to a
+// node that already exists, so the arrays are always sorted parent before child and update()
+// resolves the whole hierarchy in one forward pass. Only nodes whose local transform changed,
+// and their descendants, get their world matrix recomputed.
+class TransformSystem
+{
+public:
+	// update() spreads the work over the job system once this many nodes, counted from the first
+	// dirty one, have to be visited; below that the jobs cost more than they save
+	static const uint32_t PARALLEL_MIN_NODES = 8192;
+	static const uint32_t PARALLEL_GRAIN = 1024;
+	// deeper hierarchies take one pass per level, more than this and the serial pass is cheaper
+	static const uint32_t PARALLEL_MAX_LEVELS = 8;
+
+	TransformHandle create(TransformHandle parent = INVALID_TRANSFORM,
+		const glm::vec3& position = glm::vec3(0.0f), const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+	void clear();
+
+	void setLocalPosition(TransformHandle handle, const glm::vec3& position);
+	void setLocalRotation(TransformHandle handle, const glm::quat& rotation);
+	void setLocalScale(TransformHandle handle, const glm::vec3& scale);
+	// Takes translation and rotation from a rigid transform such as a tracked device pose,
+	// and leaves the node clean if neither changed.
+	void setLocalRigidMatrix(TransformHandle handle, const glm::mat4& mat);
+
+	// With a job system large updates run level by level, each level in parallel; the result is
+	// the same as the serial pass.
+	void update(JobSystem* jobs = nullptr);
+
+	const glm::mat4& getWorldMatrix(TransformHandle handle) const { return worldMat[handle]; }
+	const glm::vec3& getLocalPosition(TransformHandle handle) const { return localPosition[handle]; }
+	uint32_t getCount() const { return (uint32_t)parent.size(); }
+	// world matrices recomputed by the last update()
+	uint32_t getLastUpdateCount() const { return lastUpdateCount; }
+
+private:
+	void markDirty(TransformHandle handle);
+	// recomputes the node's world matrix if it or its parent changed, true if it did
+	bool updateNode(uint32_t index);
+
+	std::vector<glm::vec3> localPosition;
+	std::vector<glm::quat> localRotation;
+	std::vector<glm::vec3> localScale;
+	std::vector<glm::mat4> worldMat;
+	std::vector<TransformHandle> parent;
+	// distance from the root, a node only depends on nodes one level up
+	std::vector<uint32_t> depth;
+	uint32_t maxDepth = 0;
+
+	// localDirty marks nodes whose own TRS changed, updatedFrame stamps nodes whose world matrix
+	// changed during an update so children can see it without a separate clearing pass
+	std::vector<uint8_t> localDirty;
+	std::vector<uint32_t> updatedFrame;
+	uint32_t frame = 1;
+	uint32_t firstDirty = 0xFFFFFFFF;
+	uint32_t lastUpdateCount = 0;
+};
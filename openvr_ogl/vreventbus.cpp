@@ -0,0 +1,105 @@
+#include "vreventbus.h"
+
+#include <stdio.h>
+
+bool VREventBus::subscribe(uint32_t firstType, uint32_t lastType, EventHandler handler, void* data)
+{
+	if (subscriberCount == MAX_SUBSCRIBERS)
+	{
+		printf("Too many VR event subscribers, events %u-%u will not be delivered\n", firstType, lastType);
+		return false;
+	}
+
+	subscribers[subscriberCount++] = { firstType, lastType, handler, data };
+	return true;
+}
+
+void VREventBus::poll(vr::IVRSystem* system)
+{
+	lastEventCount = 0;
+	lastUnhandledCount = 0;
+
+	// a burst larger than the array is dispatched in several batches rather than dropped
+	uint32_t count;
+	do
+	{
+		count = 0;
+		while (count < MAX_EVENTS && system->PollNextEvent(&events[count], sizeof(vr::VREvent_t)))
+		{
+			count++;
+		}
+		dispatch(count);
+		lastEventCount += count;
+	} while (count == MAX_EVENTS);
+}
+
+void VREventBus::dispatch(uint32_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// insertion sort is stable and cheap for the handful of events a frame usually brings
+	for (uint32_t i = 1; i < count; ++i)
+	{
+		if (events[i - 1].eventType <= events[i].eventType)
+		{
+			continue;
+		}
+
+		vr::VREvent_t event = events[i];
+		uint32_t j = i;
+		while (j > 0 && events[j - 1].eventType > event.eventType)
+		{
+			events[j] = events[j - 1];
+			j--;
+		}
+		events[j] = event;
+	}
+
+	uint32_t handled = 0;
+	for (uint32_t i = 0; i < subscriberCount; ++i)
+	{
+		const Subscriber& subscriber = subscribers[i];
+		uint32_t first = lowerBound(count, subscriber.firstType);
+		uint32_t end = subscriber.lastType == UINT32_MAX ? count : lowerBound(count, subscriber.lastType + 1);
+		if (first < end)
+		{
+			subscriber.handler(subscriber.data, events + first, end - first);
+		}
+	}
+
+	// an event counts as handled if any subscription range covers its type
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		for (uint32_t j = 0; j < subscriberCount; ++j)
+		{
+			if (events[i].eventType >= subscribers[j].firstType && events[i].eventType <= subscribers[j].lastType)
+			{
+				handled++;
+				break;
+			}
+		}
+	}
+	lastUnhandledCount += count - handled;
+}
+
+uint32_t VREventBus::lowerBound(uint32_t count, uint32_t type) const
+{
+	uint32_t first = 0;
+	while (count > 0)
+	{
+		uint32_t half = count / 2;
+		if (events[first + half].eventType < type)
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	return first;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <openvr.h>
+#include <stdint.h>
+
+// Drains the OpenVR event queue once per frame into a fixed array, sorts it by event type and
+// hands every subscriber all events in its type range as one contiguous batch. Handlers are
+// plain function pointers, so there is no virtual call per event and nothing is allocated.
+class VREventBus
+{
+public:
+	static const uint32_t MAX_EVENTS = 64;
+	static const uint32_t MAX_SUBSCRIBERS = 16;
+
+	typedef void(*EventHandler)(void* data, const vr::VREvent_t* events, uint32_t count);
+
+	// handler receives the events with firstType <= eventType <= lastType, ordered by type and
+	// then by arrival
+	bool subscribe(uint32_t firstType, uint32_t lastType, EventHandler handler, void* data);
+
+	// Subscribes a member function, e.g. subscribe<Foo, &Foo::onEvents>(first, last, this)
+	template<typename T, void(T::*Method)(const vr::VREvent_t* events, uint32_t count)>
+	bool subscribe(uint32_t firstType, uint32_t lastType, T* object)
+	{
+		return subscribe(firstType, lastType, &invoke<T, Method>, object);
+	}
+
+	// Subscribes a member function that only needs to know one of the events arrived; it is
+	// called once per batch
+	template<typename T, void(T::*Method)()>
+	bool subscribe(uint32_t firstType, uint32_t lastType, T* object)
+	{
+		return subscribe(firstType, lastType, &notify<T, Method>, object);
+	}
+
+	void poll(vr::IVRSystem* system);
+
+	// events drained by the last poll() and how many of them no subscriber wanted
+	uint32_t getLastEventCount() const { return lastEventCount; }
+	uint32_t getLastUnhandledCount() const { return lastUnhandledCount; }
+
+private:
+	struct Subscriber
+	{
+		uint32_t firstType;
+		uint32_t lastType;
+		EventHandler handler;
+		void* data;
+	};
+
+	template<typename T, void(T::*Method)(const vr::VREvent_t* events, uint32_t count)>
+	static void invoke(void* data, const vr::VREvent_t* events, uint32_t count)
+	{
+		(((T*)data)->*Method)(events, count);
+	}
+
+	template<typename T, void(T::*Method)()>
+	static void notify(void* data, const vr::VREvent_t*, uint32_t)
+	{
+		(((T*)data)->*Method)();
+	}
+
+	void dispatch(uint32_t count);
+	uint32_t lowerBound(uint32_t count, uint32_t type) const;
+
+	vr::VREvent_t events[MAX_EVENTS];
+	Subscriber subscribers[MAX_SUBSCRIBERS];
+	uint32_t subscriberCount = 0;
+	uint32_t lastEventCount = 0;
+	uint32_t lastUnhandledCount = 0;
+};